@@ -0,0 +1,461 @@
+// SPDX-License-Identifier: MIT
+
+/* Feed synthetic or recorded evdev events to buttond through a pipe at
+ * a given rate, then report throughput, CPU time per event and action
+ * latencies read back from buttond's stats file.
+ *
+ * Events are written in batches of up to BATCH_EVENTS, which keeps each
+ * write atomic and a multiple of the event size. Synthetic batches end
+ * with a SYN_REPORT like a kernel frame, buttond only handles key
+ * events on it. Timestamps are rewritten to the time of the write so
+ * buttond's latencies are measured from when the event entered the
+ * pipe.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/input.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "stats.h"
+#include "time_utils.h"
+
+/* 64 * 24 = 1536 bytes, below PIPE_BUF */
+#define BATCH_EVENTS 64
+#define FIRST_CODE 10
+
+enum pattern {
+	/* key repeat events over all key codes, only --keys are bound */
+	PATTERN_FLOOD,
+	/* press and release of each key in turn */
+	PATTERN_PRESSES,
+	/* all keys held, then repeat events of the first one */
+	PATTERN_HELD,
+	/* events from --replay file */
+	PATTERN_REPLAY,
+};
+
+static const char *pattern_names[] = {
+	[PATTERN_FLOOD] = "flood",
+	[PATTERN_PRESSES] = "presses",
+	[PATTERN_HELD] = "held",
+	[PATTERN_REPLAY] = "replay",
+};
+
+struct bench {
+	enum pattern pattern;
+	uint64_t count;
+	/* events/s, 0 for as fast as the pipe allows */
+	uint64_t rate;
+	int keys;
+	/* replay file content */
+	struct input_event *replay;
+	size_t replay_count;
+	/* replay speed factor when rate is not set */
+	double speed;
+};
+
+static const char *latency_names[BUTTOND_LATENCY_COUNT] = {
+	[BUTTOND_LATENCY_READ] = "event to read",
+	[BUTTOND_LATENCY_DECISION] = "read to decision",
+	[BUTTOND_LATENCY_EXEC] = "decision to exec",
+};
+
+static struct option long_options[] = {
+	{"count",	required_argument,	0, 'n' },
+	{"rate",	required_argument,	0, 'r' },
+	{"pattern",	required_argument,	0, 'p' },
+	{"keys",	required_argument,	0, 'k' },
+	{"replay",	required_argument,	0, 'f' },
+	{"speed",	required_argument,	0, 'S' },
+	{"buttond",	required_argument,	0, 'b' },
+	{"output",	required_argument,	0, 'o' },
+	{"help",	no_argument,		0, 'h' },
+	{0,		0,			0,  0  }
+};
+
+static void help(char *argv0) {
+	printf("Usage: %s [options] [-- buttond options]\n", argv0);
+	printf("Options:\n");
+	printf("  -n, --count <n>: number of events to send (default 1000000,\n");
+	printf("                   or the replay file length)\n");
+	printf("  -r, --rate <n>: events per second, 0 for unlimited (default)\n");
+	printf("  -p, --pattern <flood|presses|held>: synthetic events (default flood)\n");
+	printf("  -k, --keys <n>: number of keys used, from code %d (default 1)\n",
+	       FIRST_CODE);
+	printf("  -f, --replay <file>: replay recorded events, e.g. from\n");
+	printf("                       cat /dev/input/event0 > file\n");
+	printf("  -S, --speed <x>: replay speed factor without --rate (default 1)\n");
+	printf("  -b, --buttond <path>: buttond binary (default ./buttond)\n");
+	printf("  -o, --output <file>: write events to file instead of running buttond\n");
+	printf("\n");
+	printf("Without buttond options, each key gets an empty action\n");
+	printf("(long press for held pattern) and debounce is disabled.\n");
+}
+
+static void load_replay(struct bench *bench, const char *path) {
+	struct stat sb;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	xassert(fd >= 0, "Could not open %s: %m", path);
+	xassert(fstat(fd, &sb) == 0, "Could not stat %s: %m", path);
+	bench->replay_count = sb.st_size / sizeof(struct input_event);
+	xassert(bench->replay_count > 0, "%s has no event", path);
+	bench->replay = xcalloc(bench->replay_count, sizeof(struct input_event));
+	xassert(read_safe(fd, bench->replay,
+			  bench->replay_count * sizeof(struct input_event))
+		== (ssize_t)(bench->replay_count * sizeof(struct input_event)),
+		"Could not read %s", path);
+	close(fd);
+	bench->pattern = PATTERN_REPLAY;
+}
+
+/* fill event i, return offset from start (ns) it is due at */
+static int64_t gen_event(struct bench *bench, uint64_t i,
+			 struct input_event *event) {
+	memset(event, 0, sizeof(*event));
+	event->type = EV_KEY;
+	switch (bench->pattern) {
+	case PATTERN_FLOOD:
+		event->code = 1 + i % (KEY_MAX - 1);
+		event->value = 2;
+		break;
+	case PATTERN_PRESSES:
+		event->code = FIRST_CODE + (i / 2) % bench->keys;
+		event->value = !(i % 2);
+		break;
+	case PATTERN_HELD:
+		event->code = FIRST_CODE + (i < (uint64_t)bench->keys ? i : 0);
+		event->value = i < (uint64_t)bench->keys ? 1 : 2;
+		break;
+	case PATTERN_REPLAY: {
+		struct input_event *first = &bench->replay[0];
+		struct input_event *last = &bench->replay[bench->replay_count - 1];
+		struct input_event *ev = &bench->replay[i % bench->replay_count];
+		/* loop over the file if count is larger */
+		int64_t loop_ns = ((last->input_event_sec - first->input_event_sec)
+				   * NSECS_IN_SEC
+				   + (last->input_event_usec - first->input_event_usec)
+				   * NSECS_IN_USEC) / bench->speed;
+
+		*event = *ev;
+		if (bench->rate)
+			break;
+		return (i / bench->replay_count) * loop_ns
+			+ ((ev->input_event_sec - first->input_event_sec)
+			   * NSECS_IN_SEC
+			   + (ev->input_event_usec - first->input_event_usec)
+			   * NSECS_IN_USEC) / bench->speed;
+	}
+	}
+	return bench->rate ? (int64_t)(i * NSECS_IN_SEC / bench->rate) : 0;
+}
+
+/* not time_gettime: we are not buttond and have no virtual clock */
+static void gettime(struct timespec *ts) {
+	xassert(clock_gettime(CLOCK_MONOTONIC, ts) == 0,
+		"Could not get time: %m");
+}
+
+static void add_ns(struct timespec *ts, const struct timespec *base,
+		   int64_t ns) {
+	ts->tv_sec = base->tv_sec + ns / NSECS_IN_SEC;
+	ts->tv_nsec = base->tv_nsec + ns % NSECS_IN_SEC;
+	if (ts->tv_nsec >= NSECS_IN_SEC) {
+		ts->tv_sec++;
+		ts->tv_nsec -= NSECS_IN_SEC;
+	}
+}
+
+/* returns the number of events written, including SYN_REPORT */
+static uint64_t send_events(struct bench *bench, int fd) {
+	struct input_event buf[BATCH_EVENTS];
+	struct timespec start, now, due;
+	/* room for SYN_REPORT, replays have their own */
+	int max = bench->pattern == PATTERN_REPLAY
+		? BATCH_EVENTS : BATCH_EVENTS - 1;
+	uint64_t i = 0, written_events = 0;
+
+	gettime(&start);
+	while (i < bench->count) {
+		int n = 0;
+
+		gettime(&now);
+		/* batch all events already due */
+		while (i < bench->count && n < max) {
+			int64_t offset = gen_event(bench, i, &buf[n]);
+
+			add_ns(&due, &start, offset);
+			if (time_cmp_ts(&due, &now) > 0) {
+				if (n > 0)
+					break;
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+						&due, NULL);
+				gettime(&now);
+			}
+			n++;
+			i++;
+		}
+		if (bench->pattern != PATTERN_REPLAY) {
+			memset(&buf[n], 0, sizeof(buf[n]));
+			buf[n].type = EV_SYN;
+			buf[n].code = SYN_REPORT;
+			n++;
+		}
+		for (int j = 0; j < n; j++) {
+			buf[j].input_event_sec = now.tv_sec;
+			buf[j].input_event_usec = now.tv_nsec / NSECS_IN_USEC;
+		}
+		ssize_t len = n * sizeof(buf[0]);
+		ssize_t written = write(fd, buf, len);
+		xassert(written == len, "Could not write events: %m");
+		written_events += n;
+	}
+	return written_events;
+}
+
+/* value under which percent of the histogram is, rounded up to the
+ * bucket boundary */
+static uint64_t hist_percentile(uint64_t *buckets, uint64_t total,
+				double percent) {
+	uint64_t target = total * percent / 100, seen = 0;
+
+	for (int b = 0; b < BUTTOND_STATS_BUCKETS; b++) {
+		seen += buckets[b];
+		if (seen > target || seen == total)
+			return (uint64_t)1 << b;
+	}
+	return 0;
+}
+
+static void report_stats(const char *path, uint64_t count) {
+	struct buttond_stats_header *stats;
+	struct stat sb;
+	uint64_t actions = 0;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	xassert(fd >= 0, "Could not open %s: %m", path);
+	xassert(fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(*stats),
+		"buttond did not write stats to %s", path);
+	stats = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	xassert(stats != MAP_FAILED, "Could not map %s: %m", path);
+	close(fd);
+	xassert(stats->magic == BUTTOND_STATS_MAGIC
+		&& stats->version == BUTTOND_STATS_VERSION
+		&& stats->key_stats_size == sizeof(stats->keys[0]),
+		"%s is not a stats file we can read", path);
+
+	printf("buttond: %"PRIu64" events read (%s), %"PRIu64" unbound dropped, %"PRIu64" reopens\n",
+	       stats->events_read,
+	       stats->events_read == count ? "all" : "MISSING EVENTS",
+	       stats->unbound_dropped, stats->reopen_count);
+	for (uint32_t k = 0; k < stats->key_count; k++)
+		actions += stats->keys[k].short_actions
+			+ stats->keys[k].long_actions
+			+ stats->keys[k].sequence_actions;
+	printf("actions: %"PRIu64"\n", actions);
+	if (!actions)
+		return;
+
+	static const double percentiles[] = { 50, 90, 99 };
+
+	/* merge all keys */
+	printf("%-18s %8s %8s %8s %8s\n", "latency (us)", "p50", "p90", "p99", "max");
+	for (int l = 0; l < BUTTOND_LATENCY_COUNT; l++) {
+		uint64_t buckets[BUTTOND_STATS_BUCKETS] = { 0 };
+		uint64_t total = 0, max = 0;
+
+		for (uint32_t k = 0; k < stats->key_count; k++) {
+			struct buttond_latency_hist *hist = &stats->keys[k].latency[l];
+
+			for (int b = 0; b < BUTTOND_STATS_BUCKETS; b++) {
+				buckets[b] += hist->buckets[b];
+				total += hist->buckets[b];
+			}
+			if (hist->max_usecs > max)
+				max = hist->max_usecs;
+		}
+		if (!total)
+			continue;
+		printf("%-18s", latency_names[l]);
+		for (int p = 0; p < 3; p++) {
+			char value[24];
+
+			snprintf(value, sizeof(value), "<%"PRIu64,
+				 hist_percentile(buckets, total, percentiles[p]));
+			printf(" %8s", value);
+		}
+		printf(" %8"PRIu64"\n", max);
+	}
+	munmap(stats, sb.st_size);
+}
+
+/* default bindings for the pattern */
+static char **default_args(struct bench *bench, int *argc) {
+	char **argv = xcalloc(bench->keys * 6 + 3, sizeof(*argv));
+	int n = 0;
+
+	argv[n++] = "--debounce-time";
+	argv[n++] = "0";
+	for (int k = 0; k < bench->keys; k++) {
+		char *code = xcalloc(1, 12);
+
+		snprintf(code, 12, "%d", FIRST_CODE + k);
+		argv[n++] = bench->pattern == PATTERN_HELD ? "-l" : "-s";
+		argv[n++] = code;
+		if (bench->pattern == PATTERN_HELD) {
+			argv[n++] = "-t";
+			argv[n++] = "600000";
+		}
+		argv[n++] = "-a";
+		argv[n++] = "";
+	}
+	*argc = n;
+	return argv;
+}
+
+static void run_buttond(struct bench *bench, const char *buttond,
+			int argc, char **argv) {
+	char stats_path[] = "/tmp/bench_events.XXXXXX";
+	struct timespec start, end;
+	struct rusage usage;
+	int pipefd[2], status, fd;
+	pid_t pid;
+
+	if (!argc)
+		argv = default_args(bench, &argc);
+
+	fd = mkstemp(stats_path);
+	xassert(fd >= 0, "Could not create stats file: %m");
+	close(fd);
+	xassert(pipe(pipefd) == 0, "Could not create pipe: %m");
+
+	char **child_argv = xcalloc(argc + 6, sizeof(*child_argv));
+	int n = 0;
+	child_argv[n++] = (char *)buttond;
+	child_argv[n++] = "--test_mode=realtime";
+	child_argv[n++] = "--stats-file";
+	child_argv[n++] = stats_path;
+	memcpy(&child_argv[n], argv, argc * sizeof(*argv));
+	n += argc;
+	child_argv[n++] = "/dev/stdin";
+
+	gettime(&start);
+	pid = fork();
+	xassert(pid >= 0, "Could not fork: %m");
+	if (pid == 0) {
+		dup2(pipefd[0], STDIN_FILENO);
+		close(pipefd[0]);
+		close(pipefd[1]);
+		fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0)
+			dup2(fd, STDOUT_FILENO);
+		execv(buttond, child_argv);
+		fprintf(stderr, "Could not exec %s: %m\n", buttond);
+		_exit(127);
+	}
+	close(pipefd[0]);
+	uint64_t sent = send_events(bench, pipefd[1]);
+	close(pipefd[1]);
+	xassert(wait4(pid, &status, 0, &usage) == pid, "wait failed: %m");
+	gettime(&end);
+	xassert(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+		"buttond did not exit cleanly (status %x)", status);
+
+	double secs = time_diff_ns(&end, &start) / (double)NSECS_IN_SEC;
+	double cpu_user = usage.ru_utime.tv_sec
+		+ usage.ru_utime.tv_usec / (double)USECS_IN_SEC;
+	double cpu_sys = usage.ru_stime.tv_sec
+		+ usage.ru_stime.tv_usec / (double)USECS_IN_SEC;
+
+	printf("%s: %"PRIu64" events in %.3fs: %.0f events/s",
+	       pattern_names[bench->pattern], bench->count, secs,
+	       bench->count / secs);
+	if (bench->rate)
+		printf(" (target %"PRIu64")", bench->rate);
+	printf("\ncpu: %.3fs user, %.3fs sys, %.0f ns/event\n",
+	       cpu_user, cpu_sys,
+	       (cpu_user + cpu_sys) * NSECS_IN_SEC / bench->count);
+	report_stats(stats_path, sent);
+	unlink(stats_path);
+}
+
+int main(int argc, char *argv[]) {
+	struct bench bench = {
+		.pattern = PATTERN_FLOOD,
+		.count = 0,
+		.keys = 1,
+		.speed = 1,
+	};
+	const char *buttond = "./buttond";
+	const char *output = NULL;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "n:r:p:k:f:S:b:o:h", long_options, NULL)) >= 0) {
+		switch (c) {
+		case 'n':
+			bench.count = strtoull(optarg, NULL, 0);
+			xassert(bench.count, "Invalid count %s", optarg);
+			break;
+		case 'r':
+			bench.rate = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			for (bench.pattern = 0; bench.pattern < PATTERN_REPLAY;
+			     bench.pattern++)
+				if (!strcmp(optarg, pattern_names[bench.pattern]))
+					break;
+			xassert(bench.pattern != PATTERN_REPLAY,
+				"Unknown pattern %s", optarg);
+			break;
+		case 'k':
+			bench.keys = strtoint(optarg);
+			xassert(errno == 0 && bench.keys > 0
+				&& FIRST_CODE + bench.keys < KEY_CNT,
+				"Invalid key count %s", optarg);
+			break;
+		case 'f':
+			load_replay(&bench, optarg);
+			break;
+		case 'S':
+			bench.speed = strtod(optarg, NULL);
+			xassert(bench.speed > 0, "Invalid speed %s", optarg);
+			break;
+		case 'b':
+			buttond = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'h':
+			help(argv[0]);
+			exit(EXIT_SUCCESS);
+		default:
+			help(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (!bench.count)
+		bench.count = bench.pattern == PATTERN_REPLAY
+			? bench.replay_count : 1000000;
+
+	if (output) {
+		int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			      0644);
+		xassert(fd >= 0, "Could not open %s: %m", output);
+		send_events(&bench, fd);
+		close(fd);
+		return 0;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	run_buttond(&bench, buttond, argc - optind, argv + optind);
+	return 0;
+}
@@ -0,0 +1,262 @@
+#!/bin/bash
+
+# Rough throughput benchmarks for buttond hot paths.
+# Set BUTTOND_BASELINE to another buttond binary to compare against it.
+
+error() {
+	printf "%s\n" "$@" >&2
+	exit 1
+}
+
+BENCHDIR=$(mktemp -d /tmp/buttond-bench.XXXXXX) || error "Could not create temporary directory"
+trap "rm -rf '$BENCHDIR'" EXIT
+
+for d in . ..; do
+	[ -e "$BUTTOND" ] || BUTTOND="$d/buttond"
+done
+[ -f "$BUTTOND" ] && [ -x "$BUTTOND" ] || error "buttond binary not found, please set BUTTOND manually"
+BUTTOND="$(realpath "$BUTTOND")"
+[ -e "$BENCH_EVENTS" ] || BENCH_EVENTS="$(dirname "$BUTTOND")/bench_events"
+[ -x "$BENCH_EVENTS" ] || error "bench_events not found, run make bench_events or set BENCH_EVENTS"
+[ -e "$SHMRING_READER" ] || SHMRING_READER="$(dirname "$BUTTOND")/shmring_reader"
+[ -z "$BUTTOND_BASELINE" ] || BUTTOND_BASELINE="$(realpath "$BUTTOND_BASELINE")"
+EVENTS="${EVENTS:-2000000}"
+TIMEFORMAT=%R
+
+# write $1 key repeat events spread over all key codes into $2
+gen_flood() {
+	"$BENCH_EVENTS" -p flood -n "$1" -o "$2"
+}
+
+# write a press and release event for $1 keys starting at code 10 into $2
+gen_presses() {
+	"$BENCH_EVENTS" -p presses -k "$1" -n "$(($1 * 2))" -o "$2"
+}
+
+# write a press event for $1 keys starting at code 10, followed by
+# repeat events of the first key into $3, for a total of $2 events.
+# Events are stamped with the current time, so long press timers
+# do not start expired.
+gen_held() {
+	"$BENCH_EVENTS" -p held -k "$1" -n "$2" -o "$3"
+}
+
+# run buttond $1 over file $2 with given key args, print events/s
+run_flood() {
+	local bin="$1" file="$2" secs
+	shift 2
+	# pipe writes up to PIPE_BUF are atomic: keep them a multiple of event size
+	secs=$( { time "$bin" --test_mode \
+		<(dd if="$file" bs=1536 status=none) "$@" > /dev/null; } 2>&1 )
+	awk -v n="$EVENTS" -v s="$secs" 'BEGIN { printf("%d", s > 0 ? n / s : 0) }'
+}
+
+bench_dispatch() {
+	local nkeys bin
+	declare -a args
+
+	gen_flood "$EVENTS" "$BENCHDIR/flood"
+	echo "== dispatch: $EVENTS key repeat events (events/s)"
+	for nkeys in 1 16 256; do
+		args=( )
+		for ((i = 1; i <= nkeys; i++)); do
+			# skip single digits, which are parsed as key names
+			args+=( -s "$((i + 9))" -a true )
+		done
+		printf "%4d keys: %10s" "$nkeys" \
+			"$(run_flood "$BUTTOND" "$BENCHDIR/flood" "${args[@]}")"
+		for bin in $BUTTOND_BASELINE; do
+			printf " (baseline %s)" \
+				"$(run_flood "$bin" "$BENCHDIR/flood" "${args[@]}")"
+		done
+		echo
+	done
+}
+
+# each key press runs one action, and buttond waits for all of them to
+# finish before exiting: total time over number of actions is a fair
+# approximation of the time to get one action running.
+bench_spawn() {
+	local nkeys=256 mode secs
+	declare -a args
+
+	gen_presses "$nkeys" "$BENCHDIR/presses"
+	echo "== spawn: $nkeys actions (us per action)"
+	for mode in -a -x; do
+		args=( --debounce-time 0 )
+		for ((i = 10; i < 10 + nkeys; i++)); do
+			args+=( -s "$i" "$mode" /bin/true )
+		done
+		secs=$( { time "$BUTTOND" --test_mode \
+			<(dd if="$BENCHDIR/presses" bs=1536 status=none) \
+			"${args[@]}" > /dev/null; } 2>&1 )
+		printf "%s: %s\n" "$([[ $mode = -a ]] && echo shell || echo direct)" \
+			"$(awk -v n="$nkeys" -v s="$secs" 'BEGIN { printf("%d", s * 1000000 / n) }')"
+	done
+}
+
+# run buttond $1 over file $2 writing one event at a time, so that
+# each event is handled in its own loop iteration.
+# Print user CPU time in ms.
+run_single() {
+	local bin="$1" file="$2" secs
+	shift 2
+	secs=$( { TIMEFORMAT=%U; time "$bin" --test_mode \
+		<(dd if="$file" bs=24 status=none) "$@" > /dev/null; } 2>&1 )
+	awk -v s="$secs" 'BEGIN { printf("%d", s * 1000) }'
+}
+
+# all keys are held with a pending long press timer while events
+# are processed one per loop iteration: cost should not depend on
+# the number of keys.
+bench_timers() {
+	local nkeys bin events=$((EVENTS / 10))
+	declare -a args
+
+	echo "== timers: $events events with all keys held (user CPU ms)"
+	for nkeys in 1 16 256; do
+		gen_held "$nkeys" "$events" "$BENCHDIR/held"
+		args=( )
+		for ((i = 10; i < 10 + nkeys; i++)); do
+			args+=( -l "$i" -t 600000 -a true )
+		done
+		printf "%4d keys: %6s" "$nkeys" \
+			"$(run_single "$BUTTOND" "$BENCHDIR/held" "${args[@]}")"
+		for bin in $BUTTOND_BASELINE; do
+			printf " (baseline %s)" \
+				"$(run_single "$bin" "$BENCHDIR/held" "${args[@]}")"
+		done
+		echo
+	done
+}
+
+# syscalls made by the main loop, e.g. to compare epoll and io_uring
+# builds (make IO_URING=1) through BUTTOND_BASELINE
+bench_syscalls() {
+	local bin
+
+	echo "== syscalls: $EVENTS key repeat events"
+	if ! command -v strace > /dev/null; then
+		echo "strace not found, skipping"
+		return
+	fi
+	[[ -e "$BENCHDIR/flood" ]] || gen_flood "$EVENTS" "$BENCHDIR/flood"
+	for bin in "$BUTTOND" $BUTTOND_BASELINE; do
+		echo "$bin:"
+		strace -c -o "$BENCHDIR/strace" "$bin" --test_mode \
+			<(dd if="$BENCHDIR/flood" bs=1536 status=none) \
+			-s 10 -a true > /dev/null
+		grep -E "total|epoll_wait|io_uring_enter|read" "$BENCHDIR/strace"
+	done
+}
+
+# events fed through a pipe at a fixed rate, with end to end latency
+# percentiles from buttond's own stats
+bench_replay() {
+	local rate bin
+
+	echo "== replay: press/release of 16 keys at fixed rates"
+	for rate in 1000 10000 100000; do
+		for bin in "$BUTTOND" $BUTTOND_BASELINE; do
+			echo "$bin:"
+			"$BENCH_EVENTS" -b "$bin" -p presses -k 16 -r "$rate" \
+				-n "$((rate * 2))"
+		done
+	done
+}
+
+# events of a held key are all published to a --shm-ring reader:
+# messages/s it gets, and how many it lost when buttond went faster
+bench_shmring() {
+	local events=$((EVENTS / 10)) ring="$BENCHDIR/ring" bpid
+
+	echo "== shm ring: $events key events to one reader"
+	if ! [ -x "$SHMRING_READER" ]; then
+		echo "shmring_reader not found, skipping"
+		return
+	fi
+	gen_held 1 "$events" "$BENCHDIR/held"
+	# input only starts once the reader is ready
+	"$BUTTOND" --test_mode --shm-ring "$ring" \
+		<(sleep 1; dd if="$BENCHDIR/held" bs=1536 status=none) \
+		-l 10 -t 600000 -a true > /dev/null &
+	bpid=$!
+	while ! [ -e "$ring" ]; do sleep 0.1; done
+	"$SHMRING_READER" -q -c "$events" "$ring"
+	wait "$bpid"
+}
+
+# time to parse bindings and start, from a config file or the same
+# bindings on the command line: short and long press for half as many
+# keys as bindings. buttond exits as soon as its empty input is done.
+bench_startup() {
+	local nbind runs=50 conf="$BENCHDIR/startup.conf" secs i
+	declare -a args
+
+	echo "== startup: $runs runs (ms per start)"
+	for nbind in 10 100 1000; do
+		args=( )
+		: > "$conf"
+		for ((i = 10; i < 10 + nbind / 2; i++)); do
+			args+=( -s "$i" -a true -l "$i" -t 2000 -a true )
+			printf "short %d: true\nlong %d 2000: true\n" "$i" "$i" >> "$conf"
+		done
+		printf "%4d bindings:" "$nbind"
+		secs=$( { time for ((i = 0; i < runs; i++)); do
+			"$BUTTOND" --test_mode -c "$conf" <(:) > /dev/null
+		done; } 2>&1 )
+		printf " config %6s" \
+			"$(awk -v n="$runs" -v s="$secs" 'BEGIN { printf("%.2f", s * 1000 / n) }')"
+		secs=$( { time for ((i = 0; i < runs; i++)); do
+			"$BUTTOND" --test_mode "${args[@]}" <(:) > /dev/null
+		done; } 2>&1 )
+		printf " argv %6s\n" \
+			"$(awk -v n="$runs" -v s="$secs" 'BEGIN { printf("%.2f", s * 1000 / n) }')"
+	done
+}
+
+# worst case latencies while a memory hog keeps pushing pages out and
+# busy loops compete for every cpu, without and with --realtime.
+# SCHED_FIFO needs root (CAP_SYS_NICE and CAP_IPC_LOCK), it is only
+# tried then.
+bench_stress() {
+	local rate=200 events=4000 mem pids=( ) i
+	declare -a args=( --debounce-time 0 )
+
+	mem=${STRESS_MEM_MB:-$(awk '/MemAvailable/ { print int($2 * 3 / 4 / 1024) }' /proc/meminfo)}
+	echo "== stress: presses of 16 keys at $rate events/s, ${mem}MB memory hog, $(nproc) cpu burners"
+	for ((i = 10; i < 26; i++)); do
+		args+=( -s "$i" -a "" )
+	done
+	# tail keeps everything when there are no newlines
+	while :; do head -c "${mem}M" /dev/zero | tail > /dev/null; done &
+	pids+=( $! )
+	for ((i = 0; i < $(nproc); i++)); do
+		while :; do :; done &
+		pids+=( $! )
+	done
+
+	echo "normal:"
+	"$BENCH_EVENTS" -b "$BUTTOND" -p presses -k 16 -r "$rate" -n "$events" \
+		-- "${args[@]}"
+	echo "--realtime:"
+	"$BENCH_EVENTS" -b "$BUTTOND" -p presses -k 16 -r "$rate" -n "$events" \
+		-- "${args[@]}" --realtime
+	if [[ "$EUID" = 0 ]]; then
+		echo "--realtime-priority 50:"
+		"$BENCH_EVENTS" -b "$BUTTOND" -p presses -k 16 -r "$rate" \
+			-n "$events" -- "${args[@]}" --realtime-priority 50
+	fi
+
+	kill "${pids[@]}"
+	wait "${pids[@]}" 2>/dev/null
+}
+
+bench_dispatch
+bench_startup
+bench_replay
+bench_shmring
+bench_spawn
+bench_timers
+bench_syscalls
+bench_stress
@@ -5,9 +5,7 @@
  */
 
 #include <getopt.h>
-#include <poll.h>
 #include <string.h>
-#include <sys/stat.h>
 
 #include "buttond.h"
 #include "version.h"
@@ -20,27 +18,58 @@
  */
 int debug = 0;
 int test_mode = 0;
+/* see time_utils.h */
+bool virtual_time;
+struct timespec virtual_now;
 #define DEFAULT_LONG_PRESS_MSECS 5000
-#define DEFAULT_SHORT_PRESS_MSECS 1000
 #define DEFAULT_DEBOUNCE_MSECS 10
 
 #define OPT_TEST 257
-#define OPT_DEBOUNCE_TIME 258
-#define OPT_EXIT_AFTER 259
+#define OPT_STATS_FILE 260
+#define OPT_DUMP_STATS 261
+#define OPT_PUBLISH 262
+#define OPT_SHM_RING 263
+#define OPT_CONTROL 264
+#define OPT_EMIT_C 265
+#define OPT_REALTIME 266
+#define OPT_REALTIME_PRIORITY 267
+#define OPT_CPU_AFFINITY 268
+#define OPT_LOG_FILE 269
+#define OPT_LOG_BINARY 270
+#define OPT_DECODE_LOG 271
 
 static struct option long_options[] = {
 	{"inotify",	required_argument,	0, 'i' },
+	{"config",	required_argument,	0, 'c' },
 	{"short",	required_argument,	0, 's' },
 	{"long",	required_argument,	0, 'l' },
+	{"sequence",	required_argument,	0, 'S' },
 	{"action",	required_argument,	0, 'a' },
+	{"exec",	required_argument,	0, 'x' },
 	{"exit-after",	no_argument,		0, OPT_EXIT_AFTER },
+	{"max-running",	required_argument,	0, OPT_MAX_RUNNING },
+	{"when-busy",	required_argument,	0, OPT_WHEN_BUSY },
+	{"queue-depth",	required_argument,	0, OPT_QUEUE_DEPTH },
+	{"time-limit",	required_argument,	0, OPT_TIME_LIMIT },
 	{"time",	required_argument,	0, 't' },
 	{"exit-timeout",required_argument,	0, 'E' },
 	{"verbose",	no_argument,		0, 'v' },
 	{"version",	no_argument,		0, 'V' },
 	{"help",	no_argument,		0, 'h' },
-	{"test_mode",	no_argument,		0, OPT_TEST },
+	{"test_mode",	optional_argument,	0, OPT_TEST },
 	{"debounce-time", required_argument,	0, OPT_DEBOUNCE_TIME },
+	{"stats-file",	required_argument,	0, OPT_STATS_FILE },
+	{"dump-stats",	required_argument,	0, OPT_DUMP_STATS },
+	{"publish",	required_argument,	0, OPT_PUBLISH },
+	{"shm-ring",	required_argument,	0, OPT_SHM_RING },
+	{"control",	required_argument,	0, OPT_CONTROL },
+	{"emit-c",	required_argument,	0, OPT_EMIT_C },
+	{"realtime",	no_argument,		0, OPT_REALTIME },
+	{"realtime-priority", required_argument, 0, OPT_REALTIME_PRIORITY },
+	{"cpu-affinity", required_argument,	0, OPT_CPU_AFFINITY },
+	{"log-file",	required_argument,	0, OPT_LOG_FILE },
+	{"log-binary",	no_argument,		0, OPT_LOG_BINARY },
+	{"decode-log",	required_argument,	0, OPT_DECODE_LOG },
 	{0,		0,			0,  0  }
 };
 
@@ -54,190 +83,152 @@ static void help(char *argv0) {
 	printf("  [files]: file(s) to get event from e.g. /dev/input/event2\n");
 	printf("           pass as many as needed to monitor multiple files\n");
 	printf("  -i <file>: same as non-option files, except if they disappear wait for them to come back\n");
+	printf("  -c/--config <file>: read inputs, keys and settings from <file>, or from\n");
+	printf("             *.conf files in <file> if it is a directory (format in README)\n");
 	printf("  -s/--short <key>  [-t/--time <time ms>] [--exit-after] -a/--action <command>:\n");
 	printf("             action on short key press\n");
 	printf("  -l/--long <key> [-t/--time <time ms>] [--exit-after] -a/--action <command>:\n");
 	printf("             action on long key press\n");
+	printf("  -S/--sequence <key>:<taps> [-t/--time <time ms>] [--exit-after] -a/--action <command>:\n");
+	printf("             action on key taps, s short and l long (e.g. ss double tap), with at\n");
+	printf("             most <time> (default %dms) between taps\n",
+	       BUTTOND_DEFAULT_TAP_GAP_MSECS);
+	printf("  --max-running <n>: for the last action, run at most <n> of its commands at once\n");
+	printf("  --when-busy drop|queue|coalesce|replace: for the last action, when <n> (default 1)\n");
+	printf("             are running ignore it (default), queue it, keep only the last one\n");
+	printf("             queued, or stop the oldest running to run it\n");
+	printf("  --queue-depth <n>: for --when-busy queue, max queued (default %d)\n",
+	       DEFAULT_QUEUE_DEPTH);
+	printf("  --time-limit <ms>: for the last action, stop (SIGTERM) its command after <ms>\n");
+	printf("  -x/--exec <command>: same as --action, except <command> is split on spaces\n");
+	printf("             and run directly without going through a shell.\n");
+	printf("             Single quotes (literal), double quotes (backslash escapes allowed\n");
+	printf("             inside) and backslash escapes are allowed, but no expansion.\n");
 	printf("  -E/--exit-timeout <time ms>: exit after <time> milliseconds\n");
 	printf("  --debounce-time <time ms>: duration to wait after keyup to merge any new keydown.\n");
 	printf("             In particular, some keyboards have a hardware repeat built-in so quick\n");
 	printf("             repetitions (default <%dms) are handled as if key was pressed continuosuly.\n",
 	       DEFAULT_DEBOUNCE_MSECS);
+	printf("  --stats-file <file>: keep statistics in <file>, updated in place\n");
+	printf("             (e.g. /run/buttond.stats)\n");
+	printf("  --dump-stats <file>: print statistics from <file> and exit\n");
+	printf("  --publish <socket>: send key events and actions to clients connecting\n");
+	printf("             to unix socket <socket> (format in publish.h)\n");
+	printf("  --shm-ring <file>: write the same messages to a ring buffer in <file>\n");
+	printf("             (e.g. /dev/shm/buttond.ring) for readers mapping it (format\n");
+	printf("             in shmring.h)\n");
+	printf("  --control <socket>: accept commands changing key bindings on unix\n");
+	printf("             socket <socket>, one per line: load, add or replace followed\n");
+	printf("             by key options as above, or remove <key>...\n");
+	printf("             (socket mode 0600: only for the user buttond runs as)\n");
+	printf("  --realtime: lock memory so key handling does not wait on page faults\n");
+	printf("  --realtime-priority <prio>: with --realtime, run SCHED_FIFO at <prio>\n");
+	printf("             (1-99), actions still run with normal scheduling\n");
+	printf("  --cpu-affinity <cpus>: with --realtime, run on <cpus> (e.g. 0,2-3)\n");
+	printf("  --emit-c <file>: write key bindings as C to <file> (- for stdout)\n");
+	printf("             and exit, to build buttond-builtin with them (see README)\n");
+	printf("  --log-file <file>: append -v output to <file> instead of stdout\n");
+	printf("  --log-binary: write -v output unformatted, for --decode-log\n");
+	printf("  --decode-log <file>: print a --log-binary log as text and exit\n");
 	printf("  -h, --help: show this help\n");
 	printf("  -V, --version: show version\n");
 	printf("  -v, --verbose: verbose (repeatable)\n\n");
 
 	printf("<key> code should preferrably be a key name or its value, which can be found\n");
 	printf("in uapi/linux/input-event-code.h or by running with -vv\n");
-	printf("(note for single digits e.g. '1' the key name is used)\n\n");
+	printf("(note for single digits e.g. '1' the key name is used)\n");
+	printf("Keys joined by + (e.g. VOLUMEUP+POWER) are a chord, pressed when all are\n");
+	printf("held: actions of its keys are then not run until they are released.\n\n");
 
 	printf("Semantics: a short press action happens on release, if and only if\n");
 	printf("the button was released before <time> (default %d) milliseconds.\n",
-	       DEFAULT_SHORT_PRESS_MSECS);
+	       BUTTOND_DEFAULT_SHORT_PRESS_MSECS);
 	printf("a long press action happens even if key is still pressed, if it has been\n");
 	printf("held for at least <time> (default %d) milliseconds.\n",
 	       DEFAULT_LONG_PRESS_MSECS);
-}
+	printf("In sequences a tap is long if held as long as the key's short press time.\n");
+	printf("Short and long actions of a key with sequences happen once no sequence\n");
+	printf("can follow that press.\n");
+	printf("Actions are run with BUTTOND_KEY, BUTTOND_CODE and BUTTOND_DURATION (ms)\n");
+	printf("set in their environment.\n\n");
 
-static int sort_actions_compare(const void *v1, const void *v2) {
-	const struct action *a1 = (const struct action*)v1;
-	const struct action *a2 = (const struct action*)v2;
-	if (a1->type == SHORT_PRESS)
-		return -1;
-	if (a2->type == SHORT_PRESS)
-		return 1;
-	if (a1->trigger_time < a2->trigger_time)
-		return -1;
-	if (a1->trigger_time > a2->trigger_time)
-		return 1;
-	return 0;
-}
-static void sort_actions(struct key *key) {
-	qsort(key->actions, key->action_count,
-		sizeof(key->actions[0]), sort_actions_compare);
+	printf("Sending SIGUSR1 prints statistics to stdout.\n");
 }
 
-static void add_input(char *path, struct state *state, bool inotify) {
-	/* skip directories */
-	struct stat sb;
-	if (stat(path, &sb) == 0) {
-		if ((sb.st_mode & S_IFMT) == S_IFDIR) {
-			fprintf(stderr, "Skipping directory %s\n", path);
-			return;
-		}
-	} else {
-		xassert(errno == ENOENT,
-			"Could not stat %s: %m", path);
-		xassert(inotify,
-			"File %s does not exist and we are not in inotify mode",
-			path);
-	}
-
-	state->input_files = xreallocarray(state->input_files,
-			state->input_count + 1,
-			sizeof(*state->input_files));
-	struct input_file *input_file = &state->input_files[state->input_count];
-	state->input_count++;
-	memset(input_file, 0, sizeof(*input_file));
-	input_file->filename = path;
-	if (inotify) {
-		input_file->inotify_wd = -1;
-		input_file->dirent = strrchr(path, '/');
-		if (input_file->dirent) {
-			input_file->dirent++;
-		} else {
-			input_file->dirent = path;
-		}
-		xassert(input_file->dirent[0] != 0,
-				"Invalid filename %s", path);
+/* buttond_ops log callback: errors to stderr, rest depending on -v */
+static void log_message(struct buttond *bd, int level, const char *fmt,
+			va_list ap) {
+	(void)bd;
+	if (level > debug)
+		return;
+	if (level) {
+		log_vprintf(fmt, ap);
+		log_printf("\n");
+		return;
 	}
+	fprintf(stderr, "ERROR: ");
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
 }
 
-struct action *add_action(char option, char *key, char *exit_timeout,
-		struct state *state) {
-	/* try to find key by name first, then by code if it failed */
-	uint16_t code = key ? find_key_by_name(key) : 0;
-	if (key && !code) {
-		code = strtou16(key);
-	}
-	xassert(!key || code,
-		"key code (%s) should be a key name or its keycode",
-		key);
-
-	struct key *cur_key = NULL;
-	for (int i = 0; i < state->key_count; i++) {
-		if (state->keys[i].code == code) {
-			cur_key = &state->keys[i];
-			break;
-		}
-	}
-	if (!cur_key) {
-		state->keys = xreallocarray(state->keys,
-					    state->key_count + 1,
-					    sizeof(*state->keys));
-		cur_key = &state->keys[state->key_count];
-		state->key_count++;
-		memset(cur_key, 0, sizeof(*cur_key));
-		cur_key->code = code;
-		cur_key->state = KEY_RELEASED;
-	}
-	cur_key->actions = xreallocarray(cur_key->actions,
-			cur_key->action_count + 1,
-			sizeof(*cur_key->actions));
-
-	/* insert at the end, we'll sort later */
-	struct action *action = &cur_key->actions[cur_key->action_count];
-	cur_key->action_count++;
-	memset(action, 0, sizeof(*action));
-	action->trigger_time = DEFAULT_SHORT_PRESS_MSECS;
-	switch (option) {
-	case 's':
-		action->type = SHORT_PRESS;
-		break;
-	case 'l':
-		action->type = LONG_PRESS;
-		break;
-	case 'E':
-		action->type = LONG_PRESS;
-		action->exit_after = true;
-		action->trigger_time = strtoint(exit_timeout);
-		xassert(action->trigger_time,
-			"Could not parse trigger time (%s): %m",
-			exit_timeout);
-		arm_key_press(cur_key, true);
-		break;
-	default:
-		xassert(false, "add_action should never be called with %c", option);
-	}
-	return action;
-}
+static const struct buttond_ops ops = {
+	.action = exec_key_action,
+	.log = log_message,
+};
 
 int main(int argc, char *argv[]) {
 	struct state state = {
-		.debounce_msecs = DEFAULT_DEBOUNCE_MSECS,
+		.bd = {
+			.ops = &ops,
+			.debounce_msecs = DEFAULT_DEBOUNCE_MSECS,
+		},
 	};
-	struct action *cur_action = NULL;
-	bool inotify_enabled = false;
+	struct buttond_action *cur_action = NULL;
+	const char *emit_path = NULL;
 
-	init_keynames();
+#ifdef BUTTOND_BUILTIN
+	state.bd = builtin_bindings;
+	state.bd.ops = &ops;
+#endif
 
 	int c;
-	while ((c = getopt_long(argc, argv, "i:s:l:a:t:E:vVh", long_options, NULL)) >= 0) {
+	while ((c = getopt_long(argc, argv, "i:c:s:l:S:a:x:t:E:vVh", long_options, NULL)) >= 0) {
 		switch (c) {
 		case 'i':
-			add_input(optarg, &state, true);
-			inotify_enabled = true;
+			config_input(&state, optarg, true);
+			break;
+		case 'c': {
+#ifdef BUTTOND_BUILTIN
+			xassert(false, "Key bindings are built in, -c cannot be used");
+#endif
+			const char *error = config_end(cur_action);
+			xassert(!error, "%s", error);
+			config_file(&state, optarg, 0);
+			/* options that follow start a new key */
+			cur_action = NULL;
 			break;
+		}
 		case 's':
 		case 'l':
-			xassert(!cur_action || cur_action->action != NULL,
-				"Must set action before specifying next key!");
-			cur_action = add_action(c, optarg, NULL, &state);
-			break;
+		case 'S':
 		case 'a':
-			xassert(cur_action,
-				"Action can only be provided after setting key code");
-			cur_action->action = optarg;
-			break;
+		case 'x':
 		case 't':
-			xassert(cur_action,
-				"Action timeout can only be set after setting key code");
-			cur_action->trigger_time = strtoint(optarg);
-			xassert(cur_action->trigger_time,
-				"Could not parse trigger time (%s): %m",
-				optarg);
-			break;
-		case OPT_EXIT_AFTER:
-			xassert(cur_action,
-				"--exit-after can only be set after setting key code");
-			cur_action->exit_after = true;
-			break;
 		case 'E':
-			xassert(!cur_action || cur_action->action != NULL,
-				"Cannot set stop timeout in the middle of defining a key");
-			/* add fake key with code 0 */
-			add_action('E', NULL, optarg, &state);
+		case OPT_EXIT_AFTER:
+		case OPT_MAX_RUNNING:
+		case OPT_WHEN_BUSY:
+		case OPT_QUEUE_DEPTH:
+		case OPT_TIME_LIMIT:
+		case OPT_DEBOUNCE_TIME: {
+#ifdef BUTTOND_BUILTIN
+			xassert(false, "Key bindings are built in, they cannot be changed with options");
+#endif
+			const char *error = config_option(&state.bd, &cur_action,
+							  c, optarg);
+			xassert(!error, "%s", error);
 			break;
+		}
 		case 'v':
 			debug++;
 			break;
@@ -248,86 +239,93 @@ int main(int argc, char *argv[]) {
 			help(argv[0]);
 			exit(EXIT_SUCCESS);
 		case OPT_TEST:
+			/* clock follows input event timestamps unless
+			 * --test_mode=realtime */
+			xassert(!optarg || !strcmp(optarg, "realtime"),
+				"Invalid test mode %s", optarg);
 			test_mode = true;
+			virtual_time = !optarg;
+			break;
+		case OPT_STATS_FILE:
+			state.stats_file = optarg;
+			break;
+		case OPT_DUMP_STATS:
+			exit(stats_dump_file(optarg));
+		case OPT_PUBLISH:
+			state.publish_path = optarg;
+			break;
+		case OPT_SHM_RING:
+			state.shmring_path = optarg;
+			break;
+		case OPT_CONTROL:
+			state.control_path = optarg;
+			break;
+		case OPT_EMIT_C:
+			emit_path = optarg;
+			break;
+		case OPT_REALTIME:
+			state.realtime = true;
+			break;
+		case OPT_REALTIME_PRIORITY:
+			state.realtime = true;
+			state.realtime_priority = strtoint(optarg);
+			xassert(errno == 0 && state.realtime_priority > 0,
+				"Invalid realtime priority %s", optarg);
+			break;
+		case OPT_CPU_AFFINITY:
+			state.realtime = true;
+			state.realtime_cpus = optarg;
 			break;
-		case OPT_DEBOUNCE_TIME:
-			state.debounce_msecs = strtoint(optarg);
-			xassert(errno == 0,
-				"Could not parse debounce time (%s): %m",
-				optarg);
+		case OPT_LOG_FILE:
+			state.log_path = optarg;
 			break;
+		case OPT_LOG_BINARY:
+			state.log_binary = true;
+			break;
+		case OPT_DECODE_LOG:
+			exit(log_decode(optarg));
 		default:
 			help(argv[0]);
 			exit(EXIT_FAILURE);
 		}
 	}
+	const char *error = config_end(cur_action);
+	xassert(!error, "%s", error);
+	if (emit_path) {
+		emit_c(&state, emit_path);
+		exit(EXIT_SUCCESS);
+	}
 	for (int i = optind; i < argc; i++) {
-		add_input(argv[i], &state, false);
+		config_input(&state, argv[i], false);
 	}
 	xassert(state.input_count > 0,
 		"No input have been given, exiting");
-	xassert(state.key_count > 0 || debug > 1,
+	xassert(state.bd.key_count > 0 || debug > 1,
 		"No action given, exiting");
-	xassert(!cur_action || cur_action->action != NULL,
-		"Last key press was defined without action");
-	for (int i = 0; i < state.key_count; i++) {
-		struct key *key = &state.keys[i];
-		sort_actions(key);
-		for (int j = 1; j < key->action_count; j++) {
-			struct action *a1, *a2;
-			a1 = &key->actions[j-1];
-			a2 = &key->actions[j];
-			xassert(a1->type == a2->type || a1->trigger_time <= a2->trigger_time,
-				"Key %s had a short key (%d) longer than its shortest long key (%d)",
-				keyname_by_code(key->code),
-				a1->trigger_time, a2->trigger_time);
-			xassert(a1->type != a2->type || a1->trigger_time != a2->trigger_time,
-				"Key %s was defined twice with %d ms %s action",
-				keyname_by_code(key->code),
-				a1->trigger_time,
-				a1->type == SHORT_PRESS ? "short" : "long");
-		}
-	}
 
-	state.pollfds = xcalloc(state.input_count + inotify_enabled, sizeof(*state.pollfds));
+	state.inotify = (struct event_source){ .type = SOURCE_INOTIFY, .fd = -1 };
+	time_gettime(&state.now);
+	log_init(&state);
+	loop_init(&state);
+	signals_init(&state);
+	timer_init(&state);
+	stats_init(&state);
+	/* checks actions, and starts exit timeout (keys with code 0) */
+	if (buttond_start(&state.bd, &state.now) < 0)
+		exit(EXIT_FAILURE);
+	publish_init(&state);
+	shmring_init(&state);
+	control_init(&state);
 	for (int i = 0; i < state.input_count; i++) {
-		state.pollfds[i].fd = -1;
-		reopen_input(&state, i);
+		reopen_input(&state, &state.input_files[i]);
 	}
 
-	if (debug > 1)
-		printf("Waiting for input, press a key to display it\n");
-
-	while (1) {
-		int timeout = compute_timeout(state.keys, state.key_count);
-		int n = poll(state.pollfds, state.input_count + inotify_enabled, timeout);
-		if (n < 0 && (errno == EINTR || errno == EAGAIN))
-			continue;
-		xassert(n >= 0, "Poll failure: %m");
+	/* last, for everything set up so far to be locked */
+	realtime_init(&state);
 
-		handle_timeouts(state.keys, state.key_count);
-		if (n == 0)
-			continue;
-		for (int i = 0; i < state.input_count; i++) {
-			if (state.pollfds[i].revents == 0)
-				continue;
-			if (!(state.pollfds[i].revents & POLLIN)) {
-				if (test_mode)
-					exit(0);
-				fprintf(stderr, "got HUP/ERR on %s. Trying to reopen.\n",
-					state.input_files[i].filename);
-				reopen_input(&state, i);
-			}
-			if (handle_input(&state, i)) {
-				reopen_input(&state, i);
-			}
-		}
-		if (inotify_enabled && state.pollfds[state.input_count].revents) {
-			xassert(state.pollfds[state.input_count].revents & POLLIN,
-				"inotify fd went bad");
-			handle_inotify(&state);
-		}
-	}
+	if (debug > 1)
+		log_printf("Waiting for input, press a key to display it\n");
 
+	loop_run(&state);
 	/* unreachable */
 }
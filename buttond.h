@@ -3,90 +3,303 @@
 #ifndef BUTTOND_H
 #define BUTTOND_H
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <linux/input.h>
 
+#include "libbuttond.h"
 #include "utils.h"
+#include "stats.h"
 #include "time_utils.h"
 
-struct action {
-	/* type of action (long/short press) */
-	enum type {
-		LONG_PRESS,
-		SHORT_PRESS,
+/* something the main loop waits on, see loop.c */
+struct event_source {
+	enum source_type {
+		SOURCE_INPUT,
+		SOURCE_INOTIFY,
+		SOURCE_SIGNAL,
+		SOURCE_TIMER,
+		SOURCE_PUBLISH,
+		SOURCE_SUBSCRIBER,
+		SOURCE_CONTROL,
+		SOURCE_CONTROL_CLIENT,
+		/* log sink, only waits for writable */
+		SOURCE_LOG,
 	} type;
-	/* cutoff time for action */
-	int trigger_time;
-	/* command to run */
-	char const *action;
-	/* whether to stop after action has been processed */
-	bool exit_after;
+	/* -1 when closed */
+	int fd;
+	/* also wait for fd to be writable, apply with loop_mod */
+	bool want_write;
+#ifdef HAVE_IO_URING
+	/* pending request when using io_uring loop */
+	struct uring_req *uring_req;
+#endif
 };
 
-struct key {
-	/* key code */
-	uint16_t code;
-	const char *name;
-
-	/* whether ts_wakeup below is valid */
-	bool has_wakeup;
-
-	/* key actions */
-	int action_count;
-	struct action *actions;
-
-	/* when key was pressed - valid for state == KEY_PRESSED or KEY_DEBOUNCE */
-	struct timeval tv_pressed;
-	/* valid when KEY_DEBOUNCE */
-	struct timeval tv_released;
-	/* when next to wakeup if has_wakeup is set */
-	struct timespec ts_wakeup;
-
-	/* state machine:
-	 * - RELEASED/PRESSED state
-	 * - DEBOUNCE: immediately after being released for DEBOUNCE_MSECS
-	 * - HANDLED: long press already handled (ignore until release)
-	 */
-	enum key_state {
-		KEY_RELEASED,
-		KEY_PRESSED,
-		KEY_DEBOUNCE,
-		KEY_HANDLED,
-	} state;
-};
+/* key events kept per SYN_REPORT frame, longer frames are split */
+#define INPUT_FRAME_EVENTS 16
 
 struct input_file {
+	/* must be first: loop hands us back the source */
+	struct event_source source;
 	/* first is full path, second is path in directory */
 	char *filename;
 	char *dirent;
 	int inotify_wd;
+	/* was successfully opened at least once */
+	bool opened;
+	/* got SYN_DROPPED: events are ignored until SYN_REPORT, then
+	 * keys are resynced with the device */
+	bool syn_dropped;
+	/* key events of the current frame, handled on SYN_REPORT */
+	struct input_event frame[INPUT_FRAME_EVENTS];
+	int frame_count;
+	/* test mode: keys down according to all events, including
+	 * ignored ones, as pipes do not have EVIOCGKEY */
+	unsigned char test_keys[KEY_CNT / 8];
+};
+
+/* per-action settings, in buttond_action.data */
+struct action_policy {
+	/* at most max_running commands of the action at a time (0 for
+	 * no limit), and what to do with triggers beyond */
+	int max_running;
+	enum busy_policy {
+		/* ignore them */
+		BUSY_DROP,
+		/* run them later, up to queue_depth of them */
+		BUSY_QUEUE,
+		/* run the last of them later */
+		BUSY_COALESCE,
+		/* signal the oldest command and run */
+		BUSY_REPLACE,
+	} when_busy;
+	int queue_depth;
+	/* signal command after time_limit ms, 0 for no limit */
+	int time_limit;
+};
+
+/* policy of action, no limits if it has none */
+static inline const struct action_policy *action_policy(const struct buttond_action *action) {
+	static const struct action_policy none;
+
+	return action->data ? action->data : &none;
+}
+
+/* running action */
+struct child {
+	pid_t pid;
+	/* NULL if key was removed by --control since */
+	struct buttond_key *key;
+	/* action->action, actions can be replaced but not their command */
+	const char *command;
+	/* start order */
+	uint64_t seq;
+	/* --time-limit: when to signal it, if time_limited */
+	struct timespec deadline;
+	bool time_limited;
+	/* was signalled, by time limit or --when-busy replace */
+	bool signalled;
+};
+
+/* action waiting for one of the same to finish, see --when-busy */
+struct pending {
+	struct buttond_key *key;
+	/* copy, actions can be replaced but not their command */
+	struct buttond_action action;
+	int64_t held;
 };
 
 struct state {
-	struct key *keys;
+	/* keys and their timers */
+	struct buttond bd;
+
 	struct input_file *input_files;
-	struct pollfd *pollfds;
-	int key_count;
+	struct child *children;
 	int input_count;
-	int debounce_msecs;
+	int child_count;
+	int child_alloc;
+	uint64_t child_seq;
+	/* children with a deadline */
+	int time_limited_count;
+	struct pending *pending;
+	int pending_count;
+	int pending_alloc;
+
+	/* main loop and its non-input sources */
+	int epoll_fd;
+#ifdef HAVE_IO_URING
+	/* set if io_uring is used instead of epoll */
+	struct uring *uring;
+#endif
+	struct event_source inotify;
+	struct event_source signal;
+	struct event_source timer;
+
+	/* current time, updated once per main loop iteration */
+	struct timespec now;
+
+	/* what timerfd is currently set to */
+	bool timer_fd_armed;
+	struct timespec timer_fd_ts;
+
+	/* --publish socket and its subscribers, see publish.c */
+	const char *publish_path;
+	struct event_source publish;
+	struct subscriber **subscribers;
+	int subscriber_count;
+	int subscriber_alloc;
+	/* messages were queued since last flush */
+	bool publish_pending;
+	/* --shm-ring file, see shmring.c */
+	const char *shmring_path;
+	struct shmring_header *shmring;
+
+	/* --control socket and its clients, see control.c */
+	const char *control_path;
+	struct event_source control;
+	struct control_client **control_clients;
+	int control_client_count;
+	int control_client_alloc;
+	/* commands whose bindings were loaded, until unused */
+	struct control_line **control_lines;
+	int control_line_count;
+	int control_line_alloc;
+
+	/* --realtime settings, see realtime.c */
+	bool realtime;
+	int realtime_priority;
+	const char *realtime_cpus;
+	struct realtime *rt;
+
+	/* -v output, see log.c */
+	const char *log_path;
+	bool log_binary;
+
+	/* statistics, possibly mapped from stats_file */
+	struct buttond_stats_header *stats;
+	size_t stats_size;
+	const char *stats_file;
 };
 
 extern int debug;
 extern int test_mode;
 
 
-/* keys.c */
-void init_keynames(void);
-uint16_t find_key_by_name (char *arg);
-const char *keyname_by_code(uint16_t code);
-void arm_key_press(struct key *key, bool reset_pressed);
-void handle_key(struct state *state, struct input_event *event, struct key *key);
-int compute_timeout(struct key *keys, int key_count);
-void handle_timeouts(struct key *keys, int key_count);
+/* config.c */
+/* long options without short equivalent */
+#define OPT_DEBOUNCE_TIME 258
+#define OPT_EXIT_AFTER 259
+#define OPT_MAX_RUNNING 272
+#define OPT_WHEN_BUSY 273
+#define OPT_QUEUE_DEPTH 274
+#define OPT_TIME_LIMIT 275
+/* --when-busy queue without --queue-depth */
+#define DEFAULT_QUEUE_DEPTH 8
+const char *config_key(const char *key, uint16_t *code);
+/* add an action for key, or chord of keys joined by + */
+const char *config_add_key(struct buttond *bd, const char *key,
+			   struct buttond_action **action);
+const char *config_option(struct buttond *bd, struct buttond_action **cur_action,
+			  int option, char *arg);
+const char *config_end(struct buttond_action *cur_action);
+void config_input(struct state *state, char *path, bool inotify);
+void config_file(struct state *state, const char *path, int depth);
+
+/* control.c */
+void control_init(struct state *state);
+void control_accept(struct state *state);
+void control_client(struct state *state, struct control_client *client,
+		    uint32_t events);
+
+/* emit.c */
+void emit_c(struct state *state, const char *path);
+/* generated by emit_c, only in buttond-builtin */
+extern struct buttond builtin_bindings;
+
+/* exec.c */
+char **split_args(const char *command);
+void free_args(char **argv);
+void exec_action(struct state *state, struct buttond_key *key,
+		 struct buttond_action *action, int64_t held);
+void exec_reap(struct state *state);
+void exec_wait_all(struct state *state);
+void exec_key_action(struct buttond *bd, struct buttond_key *key,
+		     struct buttond_action *action, int64_t held);
+/* --time-limit: earliest deadline if any, and signal children past it */
+bool exec_next_timeout(struct state *state, struct timespec *ts);
+void exec_timeouts(struct state *state);
 
 /* input.c */
-void reopen_input(struct state *state, int i);
+/* events read at a time */
+#define INPUT_BUF_EVENTS 64
+void reopen_input(struct state *state, struct input_file *input_file);
 void handle_inotify(struct state *state);
-int handle_input(struct state *state, int i);
+int handle_input_buf(struct state *state, struct input_file *input_file,
+		     struct input_event *buf, int n);
+int handle_input(struct state *state, struct input_file *input_file);
+void input_hangup(struct state *state, struct input_file *input_file);
+void input_drain(struct state *state);
+void input_reload(struct state *state, struct buttond *old);
+
+/* stats.c */
+void stats_init(struct state *state);
+void stats_reload(struct state *state, struct buttond *next);
+void stats_dump(struct buttond_stats_header *stats, FILE *out);
+int stats_dump_file(const char *path);
+
+/* log.c */
+void log_init(struct state *state);
+__attribute__((format(printf, 1, 2)))
+void log_printf(const char *fmt, ...);
+void log_vprintf(const char *fmt, va_list ap);
+void log_flush(struct state *state);
+void log_writable(struct state *state, uint32_t events);
+int log_decode(const char *path);
+
+/* publish.c */
+int unix_listen(const char *path, bool owner_only);
+void publish_init(struct state *state);
+void publish_accept(struct state *state);
+void publish_subscriber(struct state *state, struct subscriber *sub,
+			uint32_t events);
+void publish_key(struct state *state, struct input_event *event);
+void publish_action(struct state *state, struct buttond_key *key,
+		    struct buttond_action *action, int64_t held);
+void publish_flush(struct state *state);
+
+/* realtime.c */
+void realtime_init(struct state *state);
+/* around posix_spawn, for the action to run on any cpu */
+void realtime_spawn_begin(struct state *state);
+void realtime_spawn_end(struct state *state);
+
+/* shmring.c */
+struct publish_msg;
+void shmring_init(struct state *state);
+void shmring_push(struct state *state, struct publish_msg *msg);
+void shmring_wake(struct state *state);
+
+/* loop.c */
+void loop_init(struct state *state);
+void signals_init(struct state *state);
+void handle_signals(struct state *state);
+void timer_init(struct state *state);
+void timer_update(struct state *state);
+void timer_clear(struct state *state);
+void timer_advance(struct state *state, struct timespec *ts);
+void loop_add(struct state *state, struct event_source *source);
+void loop_del(struct state *state, struct event_source *source);
+void loop_mod(struct state *state, struct event_source *source);
+void loop_run(struct state *state) __attribute__((noreturn));
+
+#ifdef HAVE_IO_URING
+/* loop_uring.c */
+bool uring_init(struct state *state);
+void uring_add(struct state *state, struct event_source *source);
+void uring_del(struct state *state, struct event_source *source);
+void uring_mod(struct state *state, struct event_source *source);
+void uring_run(struct state *state) __attribute__((noreturn));
+#endif
 
 #endif
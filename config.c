@@ -0,0 +1,520 @@
+// SPDX-License-Identifier: MIT
+
+/* key binding options, shared by the command line and --control:
+ * errors are returned as messages for the caller to report, as a
+ * control client mistake must not stop buttond. */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "buttond.h"
+
+/* last error, returned by config functions */
+static char error[256];
+
+__attribute__((format(printf, 1, 2)))
+static const char *config_error(const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(error, sizeof(error), fmt, ap);
+	va_end(ap);
+	return error;
+}
+
+const char *config_key(const char *key, uint16_t *code) {
+	/* try to find key by name first, then by code if it failed */
+	*code = buttond_find_key_by_name(key);
+	if (!*code) {
+		*code = strtou16(key);
+	}
+	if (!*code)
+		return config_error("key code (%s) should be a key name or its keycode",
+				    key);
+	if (*code >= KEY_CNT)
+		return config_error("key code (%s) too large", key);
+	return NULL;
+}
+
+const char *config_add_key(struct buttond *bd, const char *key,
+			   struct buttond_action **action) {
+	uint16_t codes[BUTTOND_MAX_CHORD_KEYS];
+	char name[64];
+	const char *error;
+	int count = 0;
+
+	for (const char *c = key; ; c++) {
+		size_t len = strcspn(c, "+");
+
+		if (count == BUTTOND_MAX_CHORD_KEYS)
+			return config_error("too many keys in %s", key);
+		if (len >= sizeof(name))
+			return config_error("key code (%.*s) too long",
+					    (int)len, c);
+		memcpy(name, c, len);
+		name[len] = 0;
+		error = config_key(name, &codes[count++]);
+		if (error)
+			return error;
+		c += len;
+		if (!*c)
+			break;
+	}
+	if (count == 1) {
+		*action = buttond_add_action(bd, codes[0]);
+		xassert(*action, "Allocation failure");
+		return NULL;
+	}
+	*action = buttond_add_chord(bd, codes, count);
+	if (!*action && errno == EINVAL)
+		return config_error("chord %s needs at least two different keys",
+				    key);
+	if (!*action && errno == ENOSPC)
+		return config_error("chord %s: too many chords or keys in chords (max %d)",
+				    key, BUTTOND_MAX_CHORDS);
+	xassert(*action, "Allocation failure");
+	return NULL;
+}
+
+/* <key>:<taps> of -S, s for a short tap and l for a long one */
+static const char *config_taps(char *key, uint16_t *taps) {
+	char *c = strrchr(key, ':');
+
+	if (!c || !c[1])
+		return config_error("sequence %s should be <key>:<taps>, e.g. POWER:ss",
+				    key);
+	*c++ = 0;
+	if (strlen(c) > BUTTOND_MAX_TAPS)
+		return config_error("sequence %s too long (max %d taps)",
+				    c, BUTTOND_MAX_TAPS);
+	for (*taps = 1; *c; c++) {
+		if (*c != 's' && *c != 'l')
+			return config_error("unexpected tap %c, should be s (short) or l (long)",
+					    *c);
+		*taps = *taps << 1 | (*c == 'l');
+	}
+	return NULL;
+}
+
+static const char *add_action(struct buttond *bd, struct buttond_action **cur_action,
+			      int option, char *key, char *exit_timeout) {
+	struct buttond_action *action;
+	uint16_t taps = 0;
+
+	if (option == 'S') {
+		const char *error = config_taps(key, &taps);
+		if (error)
+			return error;
+	}
+	if (key) {
+		const char *error = config_add_key(bd, key, &action);
+		if (error)
+			return error;
+	} else {
+		action = buttond_add_action(bd, 0);
+		xassert(action, "Allocation failure");
+	}
+	switch (option) {
+	case 's':
+		action->type = BUTTOND_SHORT_PRESS;
+		break;
+	case 'l':
+		action->type = BUTTOND_LONG_PRESS;
+		break;
+	case 'S':
+		action->type = BUTTOND_SEQUENCE;
+		action->trigger_time = BUTTOND_DEFAULT_TAP_GAP_MSECS;
+		action->taps = taps;
+		break;
+	case 'E':
+		action->type = BUTTOND_LONG_PRESS;
+		action->exit_after = true;
+		action->trigger_time = strtoint(exit_timeout);
+		if (!action->trigger_time)
+			return config_error("Could not parse trigger time (%s): %m",
+					    exit_timeout);
+		/* armed by buttond_start */
+		return NULL;
+	}
+	*cur_action = action;
+	return NULL;
+}
+
+/* policy of action to set, allocated on first use */
+static struct action_policy *config_policy(struct buttond_action *action) {
+	if (!action->data)
+		action->data = xcalloc(1, sizeof(struct action_policy));
+	return action->data;
+}
+
+const char *config_option(struct buttond *bd, struct buttond_action **cur_action,
+			  int option, char *arg) {
+	struct buttond_action *action = *cur_action;
+	struct action_policy *policy;
+
+	switch (option) {
+	case 's':
+	case 'l':
+	case 'S':
+		if (action && !action->action)
+			return "Must set action before specifying next key!";
+		return add_action(bd, cur_action, option, arg, NULL);
+	case 'E':
+		if (action && !action->action)
+			return "Cannot set stop timeout in the middle of defining a key";
+		/* add fake key with code 0 */
+		return add_action(bd, cur_action, option, NULL, arg);
+	case 'a':
+		if (!action)
+			return "Action can only be provided after setting key code";
+		action->action = arg;
+		free_args(action->argv);
+		action->argv = NULL;
+		return NULL;
+	case 'x':
+		if (!action)
+			return "Action can only be provided after setting key code";
+		action->action = arg;
+		free_args(action->argv);
+		action->argv = split_args(arg);
+		if (!action->argv)
+			return config_error("Could not parse command (%s): empty or unterminated quote",
+					    arg);
+		return NULL;
+	case 't':
+		if (!action)
+			return "Action timeout can only be set after setting key code";
+		action->trigger_time = strtoint(arg);
+		if (!action->trigger_time)
+			return config_error("Could not parse trigger time (%s): %m",
+					    arg);
+		return NULL;
+	case OPT_EXIT_AFTER:
+		if (!action)
+			return "--exit-after can only be set after setting key code";
+		action->exit_after = true;
+		return NULL;
+	case OPT_MAX_RUNNING:
+		if (!action)
+			return "--max-running can only be set after setting key code";
+		policy = config_policy(action);
+		policy->max_running = strtoint(arg);
+		if (policy->max_running <= 0)
+			return config_error("Could not parse max running (%s): %m",
+					    arg);
+		return NULL;
+	case OPT_WHEN_BUSY:
+		if (!action)
+			return "--when-busy can only be set after setting key code";
+		policy = config_policy(action);
+		if (!strcmp(arg, "drop"))
+			policy->when_busy = BUSY_DROP;
+		else if (!strcmp(arg, "queue"))
+			policy->when_busy = BUSY_QUEUE;
+		else if (!strcmp(arg, "coalesce"))
+			policy->when_busy = BUSY_COALESCE;
+		else if (!strcmp(arg, "replace"))
+			policy->when_busy = BUSY_REPLACE;
+		else
+			return config_error("--when-busy %s should be drop, queue, coalesce or replace",
+					    arg);
+		/* busy is one running unless told otherwise */
+		if (!policy->max_running)
+			policy->max_running = 1;
+		return NULL;
+	case OPT_QUEUE_DEPTH:
+		if (!action)
+			return "--queue-depth can only be set after setting key code";
+		policy = config_policy(action);
+		policy->queue_depth = strtoint(arg);
+		if (policy->queue_depth <= 0)
+			return config_error("Could not parse queue depth (%s): %m",
+					    arg);
+		return NULL;
+	case OPT_TIME_LIMIT:
+		if (!action)
+			return "--time-limit can only be set after setting key code";
+		policy = config_policy(action);
+		policy->time_limit = strtoint(arg);
+		if (policy->time_limit <= 0)
+			return config_error("Could not parse time limit (%s): %m",
+					    arg);
+		return NULL;
+	case OPT_DEBOUNCE_TIME:
+		bd->debounce_msecs = strtoint(arg);
+		if (errno)
+			return config_error("Could not parse debounce time (%s): %m",
+					    arg);
+		return NULL;
+	}
+	return config_error("Unexpected option %c", option);
+}
+
+const char *config_end(struct buttond_action *cur_action) {
+	if (cur_action && !cur_action->action)
+		return "Last key press was defined without action";
+	return NULL;
+}
+
+void config_input(struct state *state, char *path, bool inotify) {
+	/* skip directories */
+	struct stat sb;
+	if (stat(path, &sb) == 0) {
+		if ((sb.st_mode & S_IFMT) == S_IFDIR) {
+			fprintf(stderr, "Skipping directory %s\n", path);
+			return;
+		}
+	} else {
+		xassert(errno == ENOENT,
+			"Could not stat %s: %m", path);
+		xassert(inotify,
+			"File %s does not exist and we are not in inotify mode",
+			path);
+	}
+
+	state->input_files = xreallocarray(state->input_files,
+			state->input_count + 1,
+			sizeof(*state->input_files));
+	struct input_file *input_file = &state->input_files[state->input_count];
+	state->input_count++;
+	memset(input_file, 0, sizeof(*input_file));
+	input_file->source.type = SOURCE_INPUT;
+	input_file->source.fd = -1;
+	input_file->filename = path;
+	if (inotify) {
+		input_file->inotify_wd = -1;
+		input_file->dirent = strrchr(path, '/');
+		if (input_file->dirent) {
+			input_file->dirent++;
+		} else {
+			input_file->dirent = path;
+		}
+		xassert(input_file->dirent[0] != 0,
+				"Invalid filename %s", path);
+	}
+}
+
+/* config files: one binding or setting per line, "<words>: <value>"
+ *   short|long <key> [<time ms>] [exec] [exit-after]: <command>
+ *   sequence <key> <taps> [<time ms>] [exec] [exit-after]: <command>
+ * where bindings also take max-running=<n>, when-busy=<policy>,
+ * queue-depth=<n> and time-limit=<ms> words like the options.
+ *   debounce-time: <ms>
+ *   exit-timeout: <ms>
+ *   input: <device>
+ *   inotify: <device>
+ *   include: <file or directory of *.conf files>
+ * Everything after ':' is kept as is (but surrounding blanks), so
+ * commands need no quoting. Empty lines and lines starting with #
+ * are ignored.
+ * Files are read at once and parsed in place: strings point into the
+ * buffer, which is never freed. */
+
+#define CONFIG_MAX_DEPTH 8
+
+static bool is_blank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* next blank separated word of *str, NULL if none */
+static char *next_word(char **str) {
+	char *word = *str;
+
+	while (is_blank(*word))
+		word++;
+	if (!*word)
+		return NULL;
+	*str = word;
+	while (**str && !is_blank(**str))
+		(*str)++;
+	if (**str)
+		*(*str)++ = 0;
+	return word;
+}
+
+/* value of a <name>=<value> word, NULL if word is not one */
+static char *config_word(char *word, const char *name) {
+	size_t len = strlen(name);
+
+	if (strncmp(word, name, len) || word[len] != '=')
+		return NULL;
+	return word + len + 1;
+}
+
+static const char *config_binding(struct state *state, int option,
+				  char *words, char *value) {
+	struct buttond_action *cur_action = NULL;
+	const char *error;
+	char *key, *word, *arg;
+	char sequence[128];
+	bool exec = false;
+
+	key = next_word(&words);
+	if (!key)
+		return "missing key";
+	/* taps are a word of their own, ':' ends the words */
+	if (option == 'S') {
+		word = next_word(&words);
+		if (!word)
+			return "missing taps";
+		snprintf(sequence, sizeof(sequence), "%s:%s", key, word);
+		key = sequence;
+	}
+	error = config_option(&state->bd, &cur_action, option, key);
+	while (!error && (word = next_word(&words))) {
+		if (!strcmp(word, "exec"))
+			exec = true;
+		else if (!strcmp(word, "exit-after"))
+			error = config_option(&state->bd, &cur_action,
+					      OPT_EXIT_AFTER, NULL);
+		else if ((arg = config_word(word, "max-running")))
+			error = config_option(&state->bd, &cur_action,
+					      OPT_MAX_RUNNING, arg);
+		else if ((arg = config_word(word, "when-busy")))
+			error = config_option(&state->bd, &cur_action,
+					      OPT_WHEN_BUSY, arg);
+		else if ((arg = config_word(word, "queue-depth")))
+			error = config_option(&state->bd, &cur_action,
+					      OPT_QUEUE_DEPTH, arg);
+		else if ((arg = config_word(word, "time-limit")))
+			error = config_option(&state->bd, &cur_action,
+					      OPT_TIME_LIMIT, arg);
+		else if (word[0] >= '0' && word[0] <= '9')
+			error = config_option(&state->bd, &cur_action, 't',
+					      word);
+		else
+			error = config_error("unexpected %s", word);
+	}
+	if (!error)
+		error = config_option(&state->bd, &cur_action,
+				      exec ? 'x' : 'a', value);
+	return error;
+}
+
+static void config_dir(struct state *state, const char *path, int depth) {
+	struct dirent **names;
+	int n;
+
+	n = scandir(path, &names, NULL, alphasort);
+	xassert(n >= 0, "Could not read %s: %m", path);
+	for (int i = 0; i < n; i++) {
+		const char *name = names[i]->d_name;
+		size_t len = strlen(name);
+
+		if (name[0] != '.' && len > 5
+		    && !strcmp(name + len - 5, ".conf")) {
+			char *file = xcalloc(1, strlen(path) + len + 2);
+
+			sprintf(file, "%s/%s", path, name);
+			config_file(state, file, depth + 1);
+			free(file);
+		}
+		free(names[i]);
+	}
+	free(names);
+}
+
+static const char *config_line(struct state *state, char *line, int depth) {
+	struct buttond_action *cur_action = NULL;
+	char *value, *end, *keyword;
+
+	value = strchr(line, ':');
+	if (!value)
+		return "expected <words>: <value>";
+	*value++ = 0;
+	while (is_blank(*value))
+		value++;
+	end = value + strlen(value);
+	while (end > value && is_blank(end[-1]))
+		*--end = 0;
+
+	keyword = next_word(&line);
+	if (!keyword)
+		return "missing keyword";
+	if (!strcmp(keyword, "short"))
+		return config_binding(state, 's', line, value);
+	if (!strcmp(keyword, "long"))
+		return config_binding(state, 'l', line, value);
+	if (!strcmp(keyword, "sequence"))
+		return config_binding(state, 'S', line, value);
+	if (next_word(&line))
+		return config_error("unexpected words after %s", keyword);
+	if (!strcmp(keyword, "debounce-time"))
+		return config_option(&state->bd, &cur_action, OPT_DEBOUNCE_TIME,
+				     value);
+	if (!strcmp(keyword, "exit-timeout"))
+		return config_option(&state->bd, &cur_action, 'E', value);
+	if (!strcmp(keyword, "input")) {
+		config_input(state, value, false);
+		return NULL;
+	}
+	if (!strcmp(keyword, "inotify")) {
+		config_input(state, value, true);
+		return NULL;
+	}
+	if (!strcmp(keyword, "include")) {
+		struct stat sb;
+
+		if (depth >= CONFIG_MAX_DEPTH)
+			return "includes nested too deep";
+		/* drop-in directories are optional */
+		if (stat(value, &sb) < 0) {
+			if (errno == ENOENT)
+				return NULL;
+			return config_error("Could not stat %s: %m", value);
+		}
+		if (S_ISDIR(sb.st_mode))
+			config_dir(state, value, depth);
+		else
+			config_file(state, value, depth + 1);
+		return NULL;
+	}
+	return config_error("unknown keyword %s", keyword);
+}
+
+void config_file(struct state *state, const char *path, int depth) {
+	struct stat sb;
+	char *buf, *line, *next;
+	int fd, lineno = 0, lines = 0;
+	ssize_t n;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	xassert(fd >= 0, "Could not open %s: %m", path);
+	xassert(fstat(fd, &sb) == 0, "Could not stat %s: %m", path);
+	if (S_ISDIR(sb.st_mode)) {
+		close(fd);
+		config_dir(state, path, depth);
+		return;
+	}
+	buf = xcalloc(1, sb.st_size + 1);
+	n = read_safe(fd, buf, sb.st_size);
+	xassert(n == sb.st_size, "Could not read %s: %s", path,
+		n < 0 ? strerror(-n) : "short read");
+	close(fd);
+
+	/* at most one key per line */
+	for (line = buf; (line = memchr(line, '\n', buf + n - line)); line++)
+		lines++;
+	xassert(buttond_reserve(&state->bd, state->bd.key_count + lines + 1) == 0,
+		"Allocation failure");
+
+	for (line = buf; line < buf + n; line = next) {
+		const char *error;
+
+		lineno++;
+		next = memchr(line, '\n', buf + n - line);
+		if (next)
+			*next++ = 0;
+		else
+			next = buf + n;
+		while (is_blank(*line))
+			line++;
+		if (!*line || *line == '#')
+			continue;
+		error = config_line(state, line, depth);
+		xassert(!error, "%s:%d: %s", path, lineno, error);
+	}
+}
@@ -0,0 +1,403 @@
+// SPDX-License-Identifier: MIT
+
+/* --control: change key bindings without restarting.
+ *
+ * Clients connect to the unix socket, only accessible to the user
+ * buttond runs as (mode 0600), and send commands, one per line,
+ * each answered with a line "ok" or "error: <message>":
+ *   load <options>: replace all bindings (exit timeout is kept)
+ *   add <options>: add actions to current bindings
+ *   replace <options>: same, dropping actions of keys given first
+ *   remove <key>...: drop all actions of keys
+ * where options are -s/-l/-S/-a/-x/-t/--exit-after/--debounce-time and
+ * --max-running/--when-busy/--queue-depth/--time-limit as on the
+ * command line, with shell-like quoting.
+ *
+ * New keys are built off to the side from a copy of the current ones,
+ * checked, and only then swapped in by buttond_reload: keys that stay
+ * keep their state, so a press in progress is not lost.
+ */
+
+/* accept4, meson already sets it */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <getopt.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "buttond.h"
+
+struct control_client {
+	/* must be first: loop hands us back the source */
+	struct event_source source;
+	/* partial command line */
+	size_t len;
+	char buf[4096];
+};
+
+static struct option control_options[] = {
+	{"short",		required_argument,	0, 's' },
+	{"long",		required_argument,	0, 'l' },
+	{"sequence",		required_argument,	0, 'S' },
+	{"action",		required_argument,	0, 'a' },
+	{"exec",		required_argument,	0, 'x' },
+	{"time",		required_argument,	0, 't' },
+	{"exit-after",		no_argument,		0, OPT_EXIT_AFTER },
+	{"max-running",		required_argument,	0, OPT_MAX_RUNNING },
+	{"when-busy",		required_argument,	0, OPT_WHEN_BUSY },
+	{"queue-depth",		required_argument,	0, OPT_QUEUE_DEPTH },
+	{"time-limit",		required_argument,	0, OPT_TIME_LIMIT },
+	{"debounce-time",	required_argument,	0, OPT_DEBOUNCE_TIME },
+	{0,			0,			0,  0  }
+};
+
+/* a command that changed bindings: actions point in its line for
+ * their command, and own their -x argv and policy. Kept as long as
+ * any action, child or pending trigger uses the line */
+struct control_line {
+	char **argv;
+	size_t size;
+	/* of its actions */
+	char ***action_argv;
+	struct action_policy **policies;
+	int action_count;
+};
+
+/* buttond_check errors for the reply */
+static char check_error[256];
+
+static void control_log(struct buttond *bd, int level, const char *fmt,
+			va_list ap) {
+	(void)bd;
+	if (level == 0)
+		vsnprintf(check_error, sizeof(check_error), fmt, ap);
+}
+
+static const struct buttond_ops control_ops = {
+	.log = control_log,
+};
+
+void control_init(struct state *state) {
+	if (!state->control_path)
+		return;
+
+	state->control.type = SOURCE_CONTROL;
+	state->control.fd = unix_listen(state->control_path, true);
+	loop_add(state, &state->control);
+}
+
+static void client_close(struct state *state, struct control_client *client) {
+	int idx;
+
+	for (idx = 0; idx < state->control_client_count; idx++)
+		if (state->control_clients[idx] == client)
+			break;
+	loop_del(state, &client->source);
+	close(client->source.fd);
+	free(client);
+	state->control_clients[idx] =
+		state->control_clients[--state->control_client_count];
+}
+
+void control_accept(struct state *state) {
+	int fd;
+
+	while ((fd = accept4(state->control.fd, NULL, NULL,
+			     SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		struct control_client *client = xcalloc(1, sizeof(*client));
+
+		client->source.type = SOURCE_CONTROL_CLIENT;
+		client->source.fd = fd;
+		if (state->control_client_count == state->control_client_alloc) {
+			state->control_client_alloc = state->control_client_alloc
+				? state->control_client_alloc * 2 : 4;
+			state->control_clients = xreallocarray(state->control_clients,
+					state->control_client_alloc,
+					sizeof(*state->control_clients));
+		}
+		state->control_clients[state->control_client_count++] = client;
+		loop_add(state, &client->source);
+	}
+	xassert(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR
+		|| errno == ECONNABORTED,
+		"Could not accept control client: %m");
+}
+
+/* add actions of key of from to next */
+static void copy_actions(struct buttond *next, struct buttond *from,
+			 struct buttond_key *key) {
+	for (int i = 0; i < key->action_count; i++) {
+		struct buttond_action *action = buttond_add_key_action(next, from, key);
+
+		xassert(action, "Allocation failure");
+		*action = key->actions[i];
+	}
+}
+
+/* -x argv and policies of actions of bd, which are not used elsewhere */
+static void free_action_data(struct buttond *bd) {
+	for (int i = 0; i < bd->key_count; i++) {
+		struct buttond_key *key = &bd->keys[i];
+
+		for (int j = 0; j < key->action_count; j++) {
+			free_args(key->actions[j].argv);
+			free(key->actions[j].data);
+		}
+	}
+}
+
+/* keep line and what actions of opts allocated, now in use */
+static void line_add(struct state *state, char **argv, size_t size,
+		     struct buttond *opts) {
+	struct control_line *line = xcalloc(1, sizeof(*line));
+	int count = 0;
+
+	for (int i = 0; i < opts->key_count; i++)
+		count += opts->keys[i].action_count;
+	line->argv = argv;
+	line->size = size;
+	line->action_argv = xcalloc(count, sizeof(*line->action_argv));
+	line->policies = xcalloc(count, sizeof(*line->policies));
+	for (int i = 0; i < opts->key_count; i++) {
+		struct buttond_key *key = &opts->keys[i];
+
+		for (int j = 0; j < key->action_count; j++) {
+			line->action_argv[line->action_count] = key->actions[j].argv;
+			line->policies[line->action_count++] = key->actions[j].data;
+		}
+	}
+	if (state->control_line_count == state->control_line_alloc) {
+		state->control_line_alloc = state->control_line_alloc
+			? state->control_line_alloc * 2 : 4;
+		state->control_lines = xreallocarray(state->control_lines,
+				state->control_line_alloc,
+				sizeof(*state->control_lines));
+	}
+	state->control_lines[state->control_line_count++] = line;
+}
+
+static bool line_has(struct control_line *line, const char *command) {
+	return command >= line->argv[0] && command < line->argv[0] + line->size;
+}
+
+static bool line_used(struct state *state, struct control_line *line) {
+	for (int i = 0; i < state->bd.key_count; i++) {
+		struct buttond_key *key = &state->bd.keys[i];
+
+		for (int j = 0; j < key->action_count; j++)
+			if (line_has(line, key->actions[j].action))
+				return true;
+	}
+	for (int i = 0; i < state->child_count; i++)
+		if (line_has(line, state->children[i].command))
+			return true;
+	for (int i = 0; i < state->pending_count; i++)
+		if (line_has(line, state->pending[i].action.action))
+			return true;
+	return false;
+}
+
+/* after a reload: free lines nothing uses anymore. Lines only used by
+ * running commands are checked again on the next reload */
+static void lines_release(struct state *state) {
+	for (int i = 0; i < state->control_line_count; ) {
+		struct control_line *line = state->control_lines[i];
+
+		if (line_used(state, line)) {
+			i++;
+			continue;
+		}
+		for (int j = 0; j < line->action_count; j++) {
+			free_args(line->action_argv[j]);
+			free(line->policies[j]);
+		}
+		free(line->action_argv);
+		free(line->policies);
+		free_args(line->argv);
+		free(line);
+		state->control_lines[i] =
+			state->control_lines[--state->control_line_count];
+	}
+}
+
+/* swap next in, next gets the previous keys */
+static void control_reload(struct state *state, struct buttond *next) {
+	/* events sent before the command follow the old bindings */
+	input_drain(state);
+
+	stats_reload(state, next);
+	xassert(buttond_reload(&state->bd, next, &state->now) == 0,
+		"Allocation failure");
+
+	/* running actions follow their key, if it still exists */
+	for (int i = 0; i < state->child_count; i++) {
+		struct child *child = &state->children[i];
+
+		if (child->key)
+			child->key = buttond_same_key(&state->bd, child->key);
+	}
+	/* queued ones too, or are dropped with it */
+	for (int i = 0; i < state->pending_count; i++) {
+		struct pending *pending = &state->pending[i];
+
+		pending->key = buttond_same_key(&state->bd, pending->key);
+		if (!pending->key) {
+			memmove(pending, pending + 1,
+				(state->pending_count - i - 1)
+				* sizeof(*pending));
+			state->pending_count--;
+			i--;
+		}
+	}
+	input_reload(state, next);
+	if (debug)
+		log_printf("reloaded %d keys, debounce %d ms\n",
+			   state->bd.key_count, state->bd.debounce_msecs);
+}
+
+static const char *control_command(struct state *state, char *line) {
+	enum { LOAD, ADD, REPLACE, REMOVE } command;
+	struct buttond *opts, *next;
+	struct buttond_action *cur_action = NULL;
+	const char *error = NULL;
+	size_t size = strlen(line) + 1;
+	char **argv;
+	int argc, c;
+
+	argv = split_args(line);
+	if (!argv)
+		return "empty command or unterminated quote";
+	for (argc = 0; argv[argc]; argc++)
+		;
+	if (!strcmp(argv[0], "load"))
+		command = LOAD;
+	else if (!strcmp(argv[0], "add"))
+		command = ADD;
+	else if (!strcmp(argv[0], "replace"))
+		command = REPLACE;
+	else if (!strcmp(argv[0], "remove"))
+		command = REMOVE;
+	else
+		error = "unknown command";
+
+	/* options, or keys to remove, as a set of keys of their own */
+	opts = xcalloc(1, sizeof(*opts));
+	opts->debounce_msecs = -1;
+	if (error) {
+		/* unknown command */
+	} else if (command == REMOVE) {
+		for (int i = 1; i < argc && !error; i++) {
+			struct buttond_action *action;
+
+			error = config_add_key(opts, argv[i], &action);
+		}
+	} else {
+		/* reset, and stop at first non option */
+		optind = 0;
+		opterr = 0;
+		while (!error && (c = getopt_long(argc, argv, "+s:l:S:a:x:t:",
+						  control_options, NULL)) >= 0) {
+			if (c == '?' || c == ':')
+				error = "invalid option";
+			else
+				error = config_option(opts, &cur_action, c,
+						      optarg);
+		}
+		if (!error && optind < argc)
+			error = "unexpected argument";
+		if (!error)
+			error = config_end(cur_action);
+	}
+	if (error) {
+		free_action_data(opts);
+		buttond_free(opts);
+		free(opts);
+		free_args(argv);
+		return error;
+	}
+
+	next = xcalloc(1, sizeof(*next));
+	next->ops = &control_ops;
+	next->debounce_msecs = opts->debounce_msecs >= 0
+		? opts->debounce_msecs : state->bd.debounce_msecs;
+	for (int i = 0; i < state->bd.key_count; i++) {
+		struct buttond_key *key = &state->bd.keys[i];
+		struct buttond_key *opt_key = buttond_same_key(opts, key);
+
+		if (command == LOAD && key->code)
+			continue;
+		/* keys only there for chords in opts have no action */
+		if (command != LOAD && command != ADD
+		    && opt_key && opt_key->action_count)
+			continue;
+		copy_actions(next, &state->bd, key);
+	}
+	if (command != REMOVE) {
+		for (int i = 0; i < opts->key_count; i++)
+			copy_actions(next, opts, &opts->keys[i]);
+	}
+
+	if (buttond_check(next) < 0) {
+		error = check_error;
+		free_action_data(opts);
+		free_args(argv);
+	} else {
+		control_reload(state, next);
+		line_add(state, argv, size, opts);
+		lines_release(state);
+	}
+	buttond_free(next);
+	free(next);
+	buttond_free(opts);
+	free(opts);
+	return error;
+}
+
+static void control_reply(struct control_client *client, const char *error) {
+	char reply[300];
+	int len;
+
+	if (error)
+		len = snprintf(reply, sizeof(reply), "error: %s\n", error);
+	else
+		len = snprintf(reply, sizeof(reply), "ok\n");
+	if (len >= (int)sizeof(reply))
+		len = sizeof(reply) - 1;
+	/* replies are small, a client not reading them loses them */
+	send(client->source.fd, reply, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void control_client(struct state *state, struct control_client *client,
+		    uint32_t events) {
+	ssize_t n;
+
+	if (!(events & EPOLLIN)) {
+		client_close(state, client);
+		return;
+	}
+	while ((n = read(client->source.fd, client->buf + client->len,
+			 sizeof(client->buf) - client->len)) > 0) {
+		char *line = client->buf, *end;
+
+		client->len += n;
+		while ((end = memchr(line, '\n',
+				     client->buf + client->len - line))) {
+			*end = 0;
+			if (debug)
+				log_printf("control command: %s\n", line);
+			control_reply(client, control_command(state, line));
+			line = end + 1;
+		}
+		client->len -= line - client->buf;
+		memmove(client->buf, line, client->len);
+		if (client->len == sizeof(client->buf)) {
+			control_reply(client, "command too long");
+			client_close(state, client);
+			return;
+		}
+	}
+	if (n == 0 || (errno != EAGAIN && errno != EINTR))
+		client_close(state, client);
+}
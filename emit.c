@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: MIT
+
+/* --emit-c: write checked bindings as C tables, to build a buttond with
+ * them (make BINDINGS=<file>, see README).
+ *
+ * Actions and sequence tries are const and already sorted and built,
+ * keys (chords included) and the key_index and key_bitmap lookup
+ * tables are static initializers: the built binary parses, sorts and
+ * allocates nothing for bindings at startup.
+ */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "buttond.h"
+
+static const char *busy_names[] = {
+	[BUSY_DROP] = "BUSY_DROP",
+	[BUSY_QUEUE] = "BUSY_QUEUE",
+	[BUSY_COALESCE] = "BUSY_COALESCE",
+	[BUSY_REPLACE] = "BUSY_REPLACE",
+};
+
+static void emit_string(FILE *out, const char *str) {
+	fputc('"', out);
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (isprint(c))
+			fputc(c, out);
+		else
+			/* always 3 digits, a digit could follow */
+			fprintf(out, "\\%03o", c);
+	}
+	fputc('"', out);
+}
+
+static void emit_actions(FILE *out, struct buttond_key *key) {
+	for (int i = 0; i < key->action_count; i++) {
+		struct buttond_action *action = &key->actions[i];
+		const struct action_policy *policy = action_policy(action);
+
+		if (action->data)
+			fprintf(out, "static struct action_policy policy_%d_%d = { .max_running = %d, .when_busy = %s, .queue_depth = %d, .time_limit = %d };\n",
+				key->code, i, policy->max_running,
+				busy_names[policy->when_busy],
+				policy->queue_depth, policy->time_limit);
+		if (!action->argv)
+			continue;
+		fprintf(out, "static char *argv_%d_%d[] = { ", key->code, i);
+		for (char **arg = action->argv; *arg; arg++) {
+			emit_string(out, *arg);
+			fprintf(out, ", ");
+		}
+		fprintf(out, "NULL };\n");
+	}
+
+	fprintf(out, "static const struct buttond_action actions_%d[] = {\n",
+		key->code);
+	for (int i = 0; i < key->action_count; i++) {
+		struct buttond_action *action = &key->actions[i];
+
+		fprintf(out, "\t{ .type = %s, .trigger_time = %d, ",
+			action->type == BUTTOND_SHORT_PRESS ? "BUTTOND_SHORT_PRESS"
+			: action->type == BUTTOND_LONG_PRESS ? "BUTTOND_LONG_PRESS"
+			: "BUTTOND_SEQUENCE",
+			action->trigger_time);
+		if (action->type == BUTTOND_SEQUENCE)
+			fprintf(out, ".taps = 0x%x, ", action->taps);
+		fprintf(out, ".action = ");
+		if (action->action)
+			emit_string(out, action->action);
+		else
+			fprintf(out, "NULL");
+		if (action->argv)
+			fprintf(out, ", .argv = argv_%d_%d", key->code, i);
+		if (action->exit_after)
+			fprintf(out, ", .exit_after = true");
+		if (action->data)
+			fprintf(out, ", .data = &policy_%d_%d", key->code, i);
+		fprintf(out, " },\n");
+	}
+	fprintf(out, "};\n\n");
+
+	if (!key->tap_node_count)
+		return;
+	fprintf(out, "static const struct buttond_tap_node taps_%d[] = {\n", key->code);
+	for (int i = 0; i < key->tap_node_count; i++) {
+		struct buttond_tap_node *node = &key->taps[i];
+
+		fprintf(out, "\t{ .next = { %d, %d }, .action = %d, .gap_msecs = %d },\n",
+			node->next[0], node->next[1], node->action,
+			node->gap_msecs);
+	}
+	fprintf(out, "};\n\n");
+}
+
+void emit_c(struct state *state, const char *path) {
+	struct buttond *bd = &state->bd;
+	FILE *out = stdout;
+
+	/* sorts actions, errors are logged */
+	if (buttond_check(bd) < 0)
+		exit(EXIT_FAILURE);
+
+	if (strcmp(path, "-")) {
+		out = fopen(path, "we");
+		xassert(out, "Could not open %s: %m", path);
+	}
+
+	fprintf(out, "// SPDX-License-Identifier: MIT\n");
+	fprintf(out, "// GENERATED FILE! buttond --emit-c\n\n");
+	fprintf(out, "#include \"buttond.h\"\n\n");
+
+	for (int i = 0; i < bd->key_count; i++) {
+		/* keys only used in chords have none */
+		if (!bd->keys[i].action_count)
+			continue;
+		fprintf(out, "/* %s */\n", bd->keys[i].code
+			? buttond_key_name(&bd->keys[i]) : "exit timeout");
+		emit_actions(out, &bd->keys[i]);
+	}
+
+	/* actions and tries are only ever read: cast away const */
+	fprintf(out, "static struct buttond_key keys[%d] = {\n", bd->key_count);
+	for (int i = 0; i < bd->key_count; i++) {
+		struct buttond_key *key = &bd->keys[i];
+
+		if (key->action_count)
+			fprintf(out, "\t{ .code = %d, .action_count = %d, .actions = (struct buttond_action *)actions_%d,\n",
+				key->code, key->action_count, key->code);
+		else
+			fprintf(out, "\t{ .code = %d,\n", key->code);
+		if (key->name) {
+			fprintf(out, "\t  .name = ");
+			emit_string(out, key->name);
+			fprintf(out, ",\n");
+		}
+		if (key->tap_node_count)
+			fprintf(out, "\t  .taps = (struct buttond_tap_node *)taps_%d, .tap_node_count = %d,\n",
+				key->code, key->tap_node_count);
+		if (key->chord_bit || key->chord_mask)
+			fprintf(out, "\t  .chord_bit = 0x%"PRIx64", .chords = 0x%"PRIx64", .chord_mask = 0x%"PRIx64",\n",
+				key->chord_bit, key->chords, key->chord_mask);
+		fprintf(out, "\t  .wakeup.heap_pos = -1, .read_latency = -1 },\n");
+	}
+	fprintf(out, "};\n\n");
+	fprintf(out, "static struct buttond_timer *timers[%d];\n\n", bd->key_count);
+
+	fprintf(out, "struct buttond builtin_bindings = {\n");
+	fprintf(out, "\t.static_keys = true,\n");
+	fprintf(out, "\t.keys = keys,\n");
+	fprintf(out, "\t.key_count = %d,\n", bd->key_count);
+	fprintf(out, "\t.key_alloc = %d,\n", bd->key_count);
+	fprintf(out, "\t.debounce_msecs = %d,\n", bd->debounce_msecs);
+	fprintf(out, "\t.timers = timers,\n");
+	if (bd->chord_count) {
+		fprintf(out, "\t.chord_count = %d,\n", bd->chord_count);
+		fprintf(out, "\t.chord_key_count = %d,\n", bd->chord_key_count);
+		fprintf(out, "\t.chord_keys = {");
+		for (int i = 0; i < bd->chord_key_count; i++)
+			fprintf(out, " %d,", bd->chord_keys[i]);
+		fprintf(out, " },\n");
+	}
+	fprintf(out, "\t.key_index = {\n");
+	for (int i = 0; i < KEY_CNT + BUTTOND_MAX_CHORDS; i++)
+		if (bd->key_index[i])
+			fprintf(out, "\t\t[%d] = %d,\n", i, bd->key_index[i]);
+	fprintf(out, "\t},\n");
+	fprintf(out, "\t.key_bitmap = {\n");
+	for (size_t i = 0; i < sizeof(bd->key_bitmap); i++)
+		if (bd->key_bitmap[i])
+			fprintf(out, "\t\t[%zu] = 0x%02x,\n", i, bd->key_bitmap[i]);
+	fprintf(out, "\t},\n");
+	fprintf(out, "};\n");
+
+	xassert(fflush(out) == 0 && !ferror(out), "Could not write %s: %m",
+		path);
+	if (out != stdout)
+		fclose(out);
+}
@@ -0,0 +1,436 @@
+// SPDX-License-Identifier: MIT
+
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include "buttond.h"
+
+extern char **environ;
+
+/* split command into a NULL-terminated argv, with minimal shell-like
+ * quoting: '...' is literal, "..." keeps blanks, and backslash escapes
+ * next character outside of single quotes (so also within "...").
+ * Returns NULL on unterminated quote. */
+char **split_args(const char *command) {
+	/* each argument needs at least one char and a separator */
+	size_t len = strlen(command);
+	char **argv = xcalloc(len / 2 + 2, sizeof(*argv));
+	char *buf = xcalloc(len + 1, 1);
+	int argc = 0;
+	const char *c = command;
+
+	while (1) {
+		while (*c == ' ' || *c == '\t' || *c == '\n')
+			c++;
+		if (!*c)
+			break;
+		argv[argc++] = buf;
+		char quote = 0;
+		for (; *c; c++) {
+			if (!quote && (*c == ' ' || *c == '\t' || *c == '\n'))
+				break;
+			if (quote && *c == quote) {
+				quote = 0;
+			} else if (!quote && (*c == '\'' || *c == '"')) {
+				quote = *c;
+			} else if (*c == '\\' && quote != '\'' && c[1]) {
+				*buf++ = *++c;
+			} else {
+				*buf++ = *c;
+			}
+		}
+		*buf++ = 0;
+		if (quote) {
+			free(argv[0]);
+			free(argv);
+			return NULL;
+		}
+	}
+	if (argc == 0) {
+		free(buf);
+		free(argv);
+		return NULL;
+	}
+	return argv;
+}
+
+void free_args(char **argv) {
+	if (!argv)
+		return;
+	free(argv[0]);
+	free(argv);
+}
+
+/* environ with key information prepended, caller frees array */
+static char **action_env(struct buttond_key *key, int64_t held, char vars[3][256]) {
+	size_t count = 0;
+	while (environ[count])
+		count++;
+	char **envp = xcalloc(count + 4, sizeof(*envp));
+	int n = 0;
+
+	/* key names, even for chords, are much shorter than that */
+	snprintf(vars[0], 256, "BUTTOND_KEY=%s", buttond_key_name(key));
+	snprintf(vars[1], 256, "BUTTOND_CODE=%d", key->code);
+	snprintf(vars[2], 256, "BUTTOND_DURATION=%"PRId64, held);
+	envp[n++] = vars[0];
+	envp[n++] = vars[1];
+	envp[n++] = vars[2];
+	for (size_t i = 0; i < count; i++) {
+		if (strncmp(environ[i], "BUTTOND_", 8) == 0)
+			continue;
+		envp[n++] = environ[i];
+	}
+	return envp;
+}
+
+/* commands of action not signalled yet, and the oldest of them */
+static int action_running(struct state *state, struct buttond_action *action,
+			  struct child **oldest) {
+	int running = 0;
+
+	*oldest = NULL;
+	for (int i = 0; i < state->child_count; i++) {
+		struct child *child = &state->children[i];
+
+		if (child->command != action->action || child->signalled)
+			continue;
+		running++;
+		if (!*oldest || child->seq < (*oldest)->seq)
+			*oldest = child;
+	}
+	return running;
+}
+
+static int key_running(struct state *state, struct buttond_key *key) {
+	int running = 0;
+
+	for (int i = 0; i < state->child_count; i++)
+		if (state->children[i].key == key)
+			running++;
+	return running;
+}
+
+static int action_queued(struct state *state, const char *command,
+			 struct pending **last) {
+	int queued = 0;
+
+	*last = NULL;
+	for (int i = 0; i < state->pending_count; i++) {
+		if (state->pending[i].action.action != command)
+			continue;
+		queued++;
+		*last = &state->pending[i];
+	}
+	return queued;
+}
+
+static void child_signal(struct state *state, struct child *child,
+			 const char *reason) {
+	if (debug)
+		log_printf("%s: stopping %s (pid %d)\n", reason,
+			   child->command, child->pid);
+	/* whole process group, sh -c would not pass it on */
+	kill(-child->pid, SIGTERM);
+	child->signalled = true;
+	if (child->time_limited) {
+		child->time_limited = false;
+		state->time_limited_count--;
+	}
+}
+
+void exec_action(struct state *state, struct buttond_key *key,
+		 struct buttond_action *action, int64_t held) {
+	const struct action_policy *policy = action_policy(action);
+	char *shell_argv[] = { "sh", "-c", (char *)action->action, NULL };
+	char vars[3][256];
+	posix_spawnattr_t attr;
+	sigset_t mask;
+	char **envp;
+	pid_t pid;
+	int rc;
+
+	/* do not leak our blocked SIGCHLD to the action */
+	sigemptyset(&mask);
+	rc = posix_spawnattr_init(&attr);
+	xassert(rc == 0, "posix_spawnattr_init failed: %s", strerror(rc));
+	posix_spawnattr_setsigmask(&attr, &mask);
+	/* own process group, to stop it with whatever it started */
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+				 | POSIX_SPAWN_SETPGROUP);
+
+	envp = action_env(key, held, vars);
+	realtime_spawn_begin(state);
+	if (action->argv)
+		rc = posix_spawnp(&pid, action->argv[0], NULL, &attr,
+				  action->argv, envp);
+	else
+		rc = posix_spawn(&pid, "/bin/sh", NULL, &attr,
+				 shell_argv, envp);
+	realtime_spawn_end(state);
+	free(envp);
+	posix_spawnattr_destroy(&attr);
+	if (rc != 0) {
+		fprintf(stderr, "Could not run %s: %s\n",
+			action->action, strerror(rc));
+		return;
+	}
+	/* posix_spawn returns once the child has exec'd */
+	struct timespec ts;
+	time_gettime(&ts);
+	buttond_stats_latency(key, BUTTOND_LATENCY_EXEC, time_diff_ns(&ts, &state->now));
+
+	if (state->child_count == state->child_alloc) {
+		state->child_alloc = state->child_alloc ? state->child_alloc * 2 : 4;
+		state->children = xreallocarray(state->children,
+						state->child_alloc,
+						sizeof(*state->children));
+	}
+	struct child *child = &state->children[state->child_count++];
+	*child = (struct child) {
+		.pid = pid,
+		.key = key,
+		.command = action->action,
+		.seq = state->child_seq++,
+	};
+	if (policy->time_limit) {
+		child->deadline = state->now;
+		time_add_ts(&child->deadline, policy->time_limit);
+		child->time_limited = true;
+		state->time_limited_count++;
+	}
+	if (debug > 1) {
+		struct pending *last;
+
+		log_printf("started %s as pid %d (%d running for key %s, %d queued)\n",
+			   action->action, pid, key_running(state, key),
+			   buttond_key_name(key),
+			   action_queued(state, action->action, &last));
+	}
+}
+
+/* --max-running reached: apply --when-busy */
+static void exec_busy(struct state *state, struct buttond_key *key,
+		      struct buttond_action *action, int64_t held,
+		      int running, struct child *oldest) {
+	const struct action_policy *policy = action_policy(action);
+	struct pending *last;
+	int queued = action_queued(state, action->action, &last);
+	int depth = policy->when_busy == BUSY_COALESCE ? 1
+		: policy->queue_depth ? policy->queue_depth
+		: DEFAULT_QUEUE_DEPTH;
+
+	switch (policy->when_busy) {
+	case BUSY_DROP:
+		break;
+	case BUSY_REPLACE:
+		if (oldest)
+			child_signal(state, oldest, "replaced");
+		exec_action(state, key, action, held);
+		return;
+	case BUSY_COALESCE:
+		if (!last)
+			break;
+		/* last trigger wins */
+		last->key = key;
+		last->action = *action;
+		last->held = held;
+		if (debug)
+			log_printf("coalesced %s (%d queued for it)\n",
+				   action->action, queued);
+		return;
+	case BUSY_QUEUE:
+		break;
+	}
+	if (policy->when_busy == BUSY_DROP || queued >= depth) {
+		if (debug)
+			log_printf("dropping %s: %d running, %d queued for it\n",
+				   action->action, running, queued);
+		return;
+	}
+	if (state->pending_count == state->pending_alloc) {
+		state->pending_alloc = state->pending_alloc
+			? state->pending_alloc * 2 : 4;
+		state->pending = xreallocarray(state->pending,
+					       state->pending_alloc,
+					       sizeof(*state->pending));
+	}
+	state->pending[state->pending_count++] = (struct pending) {
+		.key = key,
+		.action = *action,
+		.held = held,
+	};
+	if (debug)
+		log_printf("queued %s (%d queued for it)\n", action->action,
+			   queued + 1);
+}
+
+/* a command ended: run the oldest trigger queued for it, if any */
+static void exec_dequeue(struct state *state, const char *command) {
+	struct child *oldest;
+
+	for (int i = 0; i < state->pending_count; i++) {
+		struct pending pending = state->pending[i];
+
+		if (pending.action.action != command)
+			continue;
+		if (action_running(state, &pending.action, &oldest)
+		    >= action_policy(&pending.action)->max_running)
+			return;
+		/* keep queue order */
+		memmove(&state->pending[i], &state->pending[i + 1],
+			(state->pending_count - i - 1)
+			* sizeof(state->pending[0]));
+		state->pending_count--;
+		exec_action(state, pending.key, &pending.action, pending.held);
+		return;
+	}
+}
+
+/* buttond_ops action callback: run action, exit if requested */
+void exec_key_action(struct buttond *bd, struct buttond_key *key,
+		     struct buttond_action *action, int64_t held) {
+	struct state *state = container_of(bd, struct state, bd);
+
+	if ((state->subscriber_count || state->shmring) && key->code)
+		publish_action(state, key, action, held);
+	/* special keys can have no action */
+	if (action->action && action->action[0]) {
+		if (debug)
+			log_printf("running %s after %"PRId64" ms\n",
+				   action->action, held);
+		const struct action_policy *policy = action_policy(action);
+		struct child *oldest = NULL;
+		struct pending *last;
+		int running = 0;
+
+		if (policy->max_running)
+			running = action_running(state, action, &oldest);
+		/* queued ones go first */
+		if (policy->max_running
+		    && (running >= policy->max_running
+			|| action_queued(state, action->action, &last)))
+			exec_busy(state, key, action, held, running, oldest);
+		else
+			exec_action(state, key, action, held);
+	}
+	if (action->exit_after) {
+		if (debug && key->code)
+			log_printf("Exiting after processing key %s (%d)\n",
+				   buttond_key_name(key),
+				   key->code);
+		else if (debug)
+			log_printf("Exiting after stop timeout\n");
+		publish_flush(state);
+		exec_wait_all(state);
+		exit(0);
+	}
+}
+
+static void child_exited(struct state *state, pid_t pid, int status) {
+	for (int i = 0; i < state->child_count; i++) {
+		struct child *child = &state->children[i];
+		if (child->pid != pid)
+			continue;
+		if (debug && (!WIFEXITED(status) || WEXITSTATUS(status)))
+			log_printf("%s (pid %d) failed: %s %d\n",
+				   child->command, pid,
+				   WIFEXITED(status) ? "exit status" : "signal",
+				   WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status));
+		const char *command = child->command;
+
+		if (child->time_limited)
+			state->time_limited_count--;
+		*child = state->children[--state->child_count];
+		if (state->pending_count)
+			exec_dequeue(state, command);
+		return;
+	}
+}
+
+bool exec_next_timeout(struct state *state, struct timespec *ts) {
+	bool found = false;
+
+	if (!state->time_limited_count)
+		return false;
+	for (int i = 0; i < state->child_count; i++) {
+		struct child *child = &state->children[i];
+
+		if (child->time_limited
+		    && (!found || time_cmp_ts(&child->deadline, ts) < 0)) {
+			*ts = child->deadline;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void exec_timeouts(struct state *state) {
+	if (!state->time_limited_count)
+		return;
+	for (int i = 0; i < state->child_count; i++) {
+		struct child *child = &state->children[i];
+
+		if (!child->time_limited
+		    || time_cmp_ts(&child->deadline, &state->now) > 0)
+			continue;
+		child_signal(state, child, "time limit");
+		/* it does not count anymore, can grow children */
+		if (state->pending_count)
+			exec_dequeue(state, child->command);
+	}
+}
+
+/* got SIGCHLD: signals are merged so reap whatever exited */
+void exec_reap(struct state *state) {
+	int status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+		child_exited(state, pid, status);
+}
+
+/* wait for an exit until the next --time-limit deadline, the virtual
+ * clock only moves with input so it has none */
+static void exec_wait_deadline(struct state *state, struct timespec *ts) {
+	sigset_t mask;
+	int64_t nsecs;
+
+	time_gettime(&state->now);
+	nsecs = time_diff_ns(ts, &state->now);
+	if (nsecs > 0) {
+		struct timespec timeout = {
+			.tv_sec = nsecs / NSECS_IN_SEC,
+			.tv_nsec = nsecs % NSECS_IN_SEC,
+		};
+
+		/* SIGCHLD is blocked for signalfd, see signals_init */
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGCHLD);
+		sigtimedwait(&mask, NULL, &timeout);
+		time_gettime(&state->now);
+	}
+	exec_timeouts(state);
+	exec_reap(state);
+}
+
+void exec_wait_all(struct state *state) {
+	struct timespec ts;
+	int status;
+	pid_t pid;
+
+	while (state->child_count > 0) {
+		if (!virtual_time && exec_next_timeout(state, &ts)) {
+			exec_wait_deadline(state, &ts);
+			continue;
+		}
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0 && errno == EINTR)
+			continue;
+		xassert(pid > 0, "waitpid failed: %m");
+		child_exited(state, pid, status);
+	}
+}
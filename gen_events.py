@@ -2,30 +2,51 @@
 
 import struct
 import sys
-from time import clock_gettime_ns, CLOCK_MONOTONIC, sleep
+from time import sleep
 
-def gen_event(key, state):
-    ts = clock_gettime_ns(CLOCK_MONOTONIC)
+EV_SYN = 0
+EV_KEY = 1
+SYN_REPORT = 0
+
+# buttond --test_mode runs on a virtual clock that starts at 0 and
+# follows event timestamps, so we only need to pretend time passes.
+now_ms = 0
+
+def gen_event(ev_type, key, state):
     sys.stdout.buffer.write(struct.pack('LLHHI',
-            int(ts / 1000000000), (int(ts/1000) % 1000000),
-            1, key, state))
+            now_ms // 1000, (now_ms % 1000) * 1000,
+            ev_type, key, state))
     sys.stdout.buffer.flush()
 
 
 def main():
-    # wait some for buttond init
-    sleep(1)
+    global now_ms
+
+    # leave some time for buttond init
+    now_ms = 1000
     for command in sys.argv[1:]:
         try:
-            [key, state, time] = command.split(',')
-            gen_event(int(key), int(state))
-            sleep(int(time)/1000)
+            # key,state,time is a key event in its own frame like the
+            # kernel sends, type,code,value,time a single event (e.g.
+            # 0,3,0,0 for SYN_DROPPED, 0,0,0,0 for SYN_REPORT)
+            fields = [int(field) for field in command.split(',')]
+            if len(fields) == 3:
+                [key, state, time] = fields
+                gen_event(EV_KEY, key, state)
+                gen_event(EV_SYN, SYN_REPORT, 0)
+            else:
+                [ev_type, key, state, time] = fields
+                gen_event(ev_type, key, state)
+            now_ms += time
         except ValueError:
+            # garbage to test reopen: make sure buttond reads it alone
+            sleep(0.1)
             sys.stdout.buffer.write(command.encode('utf-8'))
             sys.stdout.buffer.flush()
             sleep(0.1)
-    # ... and some more for debouncing
-    sleep(1)
+    # ... and some more for debouncing: SYN_REPORT moves the clock
+    now_ms += 1000
+    gen_event(EV_SYN, 0, 0)
 
 if __name__ == '__main__':
     main()
@@ -14,31 +14,182 @@ cat <<EOF
 #ifndef BUTTOND_KEYNAMES_H
 #define BUTTOND_KEYNAMES_H
 
+#include <stdint.h>
+
+#define NAME_NONE 0xffff
+
+struct code_name {
+	uint16_t code;
+	/* offset in strings, NAME_NONE for empty slots */
+	uint16_t name;
+};
+
+/* names of one event type's codes, without prefix (e.g. KEY_) */
+struct code_names {
+	/* all names, NUL separated */
+	const char *strings;
+	/* offset in strings of the name printed for each code */
+	const uint16_t *by_code;
+	uint16_t code_count;
+	/* perfect hash: name is in slot
+	 *   hash(name, seeds[hash(name, 0) % seed_count]) % slot_count
+	 * with hash() in keys.c */
+	const uint16_t *seeds;
+	uint16_t seed_count;
+	const struct code_name *slots;
+	uint16_t slot_count;
+};
 
 EOF
-$AWK '/^#define KEY_/ { $3=$3+0; if ($3) { gsub(/KEY_/, "", $2); keys[$3] = $2; }}
-	END {
-		printf("const char allkeynames[] =\n  \"");
-		max = 0;
-		for (key in keys) {
-			key=key+0; # cast to int
-			# 0x2ff is KEY_MAX, optimize for hole before it
-			if (key > max && key < '"$((0x2ff))"') {
-				max = key;
+$AWK '
+function hash(s, seed,    h, m, i) {
+	# must match name_hash() in keys.c
+	h = seed;
+	m = 31 + 2 * seed;
+	for (i = 1; i <= length(s); i++)
+		h = (h * m + ord[substr(s, i, 1)]) % 2147483647;
+	return h;
+}
+
+# biggest buckets first, look for a seed that puts all their names in
+# free slots. Returns 0 if a bucket found none.
+function place(t, nb, ns,    i, b, size, maxsize, seed, j, ok, slot, tmp) {
+	for (b = 0; b < nb; b++)
+		bsize[b] = 0;
+	for (i = 1; i <= count[t]; i++) {
+		b = hash(name[t, i], 0) % nb;
+		bmember[b, ++bsize[b]] = i;
+	}
+	maxsize = 0;
+	for (b = 0; b < nb; b++) {
+		seeds[t, b] = 0;
+		if (bsize[b] > maxsize)
+			maxsize = bsize[b];
+	}
+	for (slot = 0; slot < ns; slot++)
+		slots[t, slot] = 0;
+	for (size = maxsize; size > 0; size--) {
+		for (b = 0; b < nb; b++) {
+			if (bsize[b] != size)
+				continue;
+			for (seed = 1; seed < 65535; seed++) {
+				split("", tmp);
+				ok = 1;
+				for (j = 1; j <= size && ok; j++) {
+					slot = hash(name[t, bmember[b, j]], seed) % ns;
+					if (slots[t, slot] || (slot in tmp))
+						ok = 0;
+					tmp[slot] = 1;
+				}
+				if (ok)
+					break;
 			}
-		}
-		col = 2;
-		for (i=1; i <= max; i++) {
-			col+=length(keys[i])+4;
-			if (col > 70) {
-				printf("\"\n  \"");
-				col = 2;
+			if (!ok)
+				return 0;
+			seeds[t, b] = seed;
+			for (j = 1; j <= size; j++) {
+				slot = hash(name[t, bmember[b, j]], seed) % ns;
+				slots[t, slot] = bmember[b, j];
 			}
-			printf("%s\\000", keys[i]);
 		}
-		printf("\";");
-	}' < /usr/include/linux/input-event-codes.h
-cat <<EOF
+	}
+	return 1;
+}
+
+# print s wrapped at 70 columns, after a tab
+function out(s) {
+	if (col + length(s) > 70) {
+		printf("\n\t");
+		col = 8;
+	}
+	printf("%s", s);
+	col += length(s);
+}
+
+function table(t, lower,    i, c, off, str, nb, ns) {
+	# strings
+	printf("static const char %s_name_strings[] =\n\t\"", lower);
+	col = 9;
+	off = 0;
+	for (i = 1; i <= count[t]; i++) {
+		offset[t, i] = off;
+		str = name[t, i] "\\000";
+		off += length(name[t, i]) + 1;
+		if (col + length(str) > 70) {
+			printf("\"\n\t\"");
+			col = 9;
+		}
+		printf("%s", str);
+		col += length(str);
+	}
+	printf("\";\n\n");
+
+	printf("static const uint16_t %s_name_by_code[%d] = {\n\t", lower, max[t] + 1);
+	col = 8;
+	for (c = 0; c <= max[t]; c++)
+		out(((t, c) in by_code ? offset[t, by_code[t, c]] : "NAME_NONE") ", ");
+	printf("\n};\n\n");
+
+	# about 4 names per bucket, 80% full slots
+	nb = int(count[t] / 4) + 1;
+	for (ns = count[t] + int(count[t] / 4) + 1; !place(t, nb, ns); ns++)
+		;
+	printf("static const uint16_t %s_name_seeds[%d] = {\n\t", lower, nb);
+	col = 8;
+	for (i = 0; i < nb; i++)
+		out(seeds[t, i] ", ");
+	printf("\n};\n\n");
+
+	printf("static const struct code_name %s_name_slots[%d] = {\n\t", lower, ns);
+	col = 8;
+	for (i = 0; i < ns; i++) {
+		if (slots[t, i])
+			out("{ " code[t, slots[t, i]] ", " offset[t, slots[t, i]] " }, ");
+		else
+			out("{ 0, NAME_NONE }, ");
+	}
+	printf("\n};\n\n");
 
+	printf("static const struct code_names %s_names = {\n", lower);
+	printf("\t.strings = %s_name_strings,\n", lower);
+	printf("\t.by_code = %s_name_by_code,\n", lower);
+	printf("\t.code_count = %d,\n", max[t] + 1);
+	printf("\t.seeds = %s_name_seeds,\n", lower);
+	printf("\t.seed_count = %d,\n", nb);
+	printf("\t.slots = %s_name_slots,\n", lower);
+	printf("\t.slot_count = %d,\n", ns);
+	printf("};\n\n");
+}
+
+BEGIN {
+	for (i = 32; i < 127; i++)
+		ord[sprintf("%c", i)] = i;
+}
+
+# numeric values only: skips aliases and KEY_CNT.., and the _MAX sentinels
+# (not KEY_BRIGHTNESS_MAX and the like)
+/^#define (KEY|SW|ABS)_/ && $3 ~ /^(0x[0-9a-fA-F]+|[0-9]+)$/ && $2 !~ /^(KEY|SW|ABS)_MAX$/ {
+	t = $2;
+	sub(/_.*/, "", t);
+	sub(/^[A-Z]*_/, "", $2);
+	$3 = $3 + 0;
+	# 0 is no key for buttond
+	if (t == "KEY" && !$3)
+		next;
+	i = ++count[t];
+	name[t, i] = $2;
+	code[t, i] = $3;
+	# last name wins when several have the same code
+	by_code[t, $3] = i;
+	if ($3 > max[t])
+		max[t] = $3;
+}
+
+END {
+	table("KEY", "key");
+	table("SW", "sw");
+	table("ABS", "abs");
+}' < /usr/include/linux/input-event-codes.h
+cat <<EOF
 #endif
 EOF
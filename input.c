@@ -2,7 +2,6 @@
 
 #include <fcntl.h>
 #include <linux/input.h>
-#include <poll.h>
 #include <string.h>
 #include <sys/inotify.h>
 #include <sys/stat.h>
@@ -47,14 +46,10 @@ static void touch(char *dir, char *file) {
 	xassert(close(fd) == 0, "Could not close newly-opened fd (%s): %m", buf);
 }
 
-/* simple bitmask is_set helper */
-static bool is_bit_set(unsigned char *bitmap, int code) {
-	xassert(code < KEY_MAX, "Invalid code %d\n", code);
-	return !!(bitmap[code / 8] & (1 << (code % 8)));
-}
-
-/* refresh currently down keys after open */
-static void check_pressed_keys(struct state *state, int fd) {
+/* refresh currently down keys after open, or after keys changed:
+ * then only keys that were not in old are checked */
+static void check_pressed_keys(struct state *state, int fd,
+			       struct buttond *old) {
 	/* not applicable to pipes in tests... */
 	if (test_mode)
 		return;
@@ -65,42 +60,126 @@ static void check_pressed_keys(struct state *state, int fd) {
 	xassert(max >= 0, "EVIOCGKEY failed: %m");
 	max = max * 8;
 
-	if (debug > 1) {
+	if (debug > 1 && !old) {
 		for (int i = 0; i < KEY_MAX; i++) {
 			if (!is_bit_set(key_states, i))
 				continue;
-			printf("key %s (%d) was up on open\n",
-				keyname_by_code(i), i);
+			log_printf("key %s (%d) was up on open\n",
+				buttond_keyname_by_code(i), i);
 		}
 	}
 
-	for (int i = 0; i < state->key_count; i++) {
-		struct key *key = &state->keys[i];
-		if (key->code > max)
+	for (int i = 0; i < state->bd.key_count; i++) {
+		struct buttond_key *key = &state->bd.keys[i];
+		/* also skips chords, pressed through their keys */
+		if (key->code >= max || (old && buttond_key_by_code(old, key->code)))
 			continue;
 		if (is_bit_set(key_states, key->code)) {
 			if (debug == 1) {
-				printf("key %s (%d) was up on open\n",
-					keyname_by_code(key->code), key->code);
+				log_printf("key %s (%d) was up on open\n",
+					buttond_keyname_by_code(key->code), key->code);
 			}
-			arm_key_press(key, true);
+			buttond_key_pressed(&state->bd, key, &state->now);
+		}
+	}
+}
+
+/* after SYN_DROPPED: some events were lost, so bring keys in line
+ * with what the device says is down now. Keys released meanwhile run
+ * no action, as we do not know for how long they were held.
+ * Keys the device does not have are left alone, they might be held
+ * on another input */
+static void resync_keys(struct state *state, struct input_file *input_file) {
+	unsigned char key_states[KEY_MAX/8 + 1] = { 0 };
+	unsigned char key_bits[KEY_MAX/8 + 1];
+	int fd = input_file->source.fd;
+
+	if (test_mode) {
+		memcpy(key_states, input_file->test_keys,
+		       sizeof(input_file->test_keys));
+		memset(key_bits, 0xff, sizeof(key_bits));
+	} else {
+		memset(key_bits, 0, sizeof(key_bits));
+		xassert(ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits) >= 0,
+			"EVIOCGBIT failed: %m");
+		xassert(ioctl(fd, EVIOCGKEY(sizeof(key_states)), key_states) >= 0,
+			"EVIOCGKEY failed: %m");
+	}
+
+	for (int i = 0; i < state->bd.key_count; i++) {
+		struct buttond_key *key = &state->bd.keys[i];
+
+		/* code 0 is our exit timeout, not a real key, and chords
+		 * follow their keys */
+		if (!key->code || key->code >= KEY_CNT
+		    || !is_bit_set(key_bits, key->code))
+			continue;
+
+		bool down = is_bit_set(key_states, key->code);
+		bool held = key->state == BUTTOND_KEY_PRESSED
+			|| key->state == BUTTOND_KEY_HANDLED;
+
+		if (down == held)
+			continue;
+		/* released and not yet decided: nothing lost */
+		if (!down && key->state == BUTTOND_KEY_DEBOUNCE)
+			continue;
+		if (debug)
+			log_printf("key %s (%d) %s while events were lost\n",
+				   buttond_keyname_by_code(key->code), key->code,
+				   down ? "pressed" : "released");
+		if (down)
+			buttond_key_pressed(&state->bd, key, &state->now);
+		else
+			buttond_key_released(&state->bd, key, &state->now);
+	}
+}
+
+/* restrict events the kernel sends us to keys we handle:
+ * everything else would only wake us up to be ignored.
+ * EV_SYN is left alone as SYN_REPORT is what wakes readers up. */
+static void set_event_mask(struct state *state, int fd,
+			   const char *filename) {
+	/* -vv needs ignored keys to display them */
+	if (debug > 1)
+		return;
+
+	unsigned char none[KEY_CNT / 8] = { 0 };
+	struct input_mask mask = {
+		.codes_size = sizeof(none),
+		.codes_ptr = (uintptr_t)none,
+	};
+	for (unsigned int type = EV_SYN + 1; type < EV_CNT; type++) {
+		mask.type = type;
+		if (type == EV_KEY)
+			mask.codes_ptr = (uintptr_t)state->bd.key_bitmap;
+		else
+			mask.codes_ptr = (uintptr_t)none;
+		if (ioctl(fd, EVIOCSMASK, &mask) != 0) {
+			/* not fatal, we filter events ourselves anyway */
+			if (debug)
+				log_printf("Could not set event mask on %s (%m), all events will be read\n",
+					   filename);
+			return;
 		}
 	}
 }
 
 /* return 1 if something was done */
-static int inotify_watch(struct input_file *input_file,
-			  struct pollfd *inotify) {
+static int inotify_watch(struct state *state,
+			 struct input_file *input_file) {
+	struct event_source *inotify = &state->inotify;
+
 	/* already setup - nothing to do! */
 	if (input_file->inotify_wd >= 0)
 		return 0;
 
 	/* setup inotify if not done yet */
-	if (!inotify->events) {
+	if (inotify->fd < 0) {
 		inotify->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
 		xassert(inotify->fd >= 0,
 			"Inotify init failed: %m");
-		inotify->events = POLLIN;
+		loop_add(state, inotify);
 	}
 
 	fprintf(stderr, "setting up inotify watch for %s\n",
@@ -148,14 +227,14 @@ again:
 	return 1;
 }
 
-void reopen_input(struct state *state, int i) {
-	struct input_file *input_file = &state->input_files[i];
-	struct pollfd *pollfd = &state->pollfds[i];
-	struct pollfd *inotify = &state->pollfds[state->input_count];
-	if (pollfd->fd >= 0) {
-		close(pollfd->fd);
-		pollfd->fd = -1;
-		pollfd->events = 0;
+void reopen_input(struct state *state, struct input_file *input_file) {
+	struct event_source *source = &input_file->source;
+	if (input_file->opened)
+		state->stats->reopen_count++;
+	if (source->fd >= 0) {
+		loop_del(state, source);
+		close(source->fd);
+		source->fd = -1;
 	}
 	int fd = open(input_file->filename,
 		      O_RDONLY | O_NONBLOCK | O_CLOEXEC);
@@ -165,7 +244,7 @@ void reopen_input(struct state *state, int i) {
 		xassert(input_file->dirent,
 			"%s: %m.\nInotify is not enabled, aborting.",
 			input_file->filename);
-		if (inotify_watch(input_file, inotify) == 0)
+		if (inotify_watch(state, input_file) == 0)
 			return;
 		/* this was racy: retry to open here, just in case. */
 		fd = open(input_file->filename,
@@ -181,19 +260,26 @@ void reopen_input(struct state *state, int i) {
 			"Could not request clock monotonic timestamps from %s. Ignoring this file.\n",
 			input_file->filename);
 		if (input_file->dirent)
-			inotify_watch(input_file, inotify);
+			inotify_watch(state, input_file);
 		else if (debug < 2)
 			xassert(input_file->dirent,
 				"Inotify not enabled for this file: aborting");
 		return;
 	}
-	check_pressed_keys(state, fd);
-
-	pollfd->fd = fd;
-	pollfd->events = POLLIN;
+	/* same for masks */
+	if (!test_mode)
+		set_event_mask(state, fd, input_file->filename);
+	check_pressed_keys(state, fd, NULL);
+
+	source->fd = fd;
+	input_file->syn_dropped = false;
+	input_file->frame_count = 0;
+	input_file->opened = true;
+	loop_add(state, source);
 }
 
 static void handle_inotify_event(struct state *state, struct inotify_event *event) {
+	state->stats->inotify_events++;
 	/* skip events we don't care about */
 	if (!(event->mask & INOTIFY_WATCH_FLAGS))
 		return;
@@ -204,13 +290,12 @@ static void handle_inotify_event(struct state *state, struct inotify_event *even
 		if (event->wd != input_file->inotify_wd)
 			continue;
 		if (debug > 2) {
-			printf("got inotify event for %s's directory (%s): %x\n",
-			       input_file->filename, event->name, event->mask);
+			log_printf("got inotify event for %s's directory (%s): %x\n",
+				   input_file->filename, event->name, event->mask);
 		}
 		if ((event->mask & IN_DELETE_SELF)) {
 			input_file->inotify_wd = -1;
-			inotify_watch(input_file,
-				      &state->pollfds[state->input_count]);
+			inotify_watch(state, input_file);
 			/* we might have been raced there with yet another
 			 * re-creation, so also try to reopen even if it likely
 			 * won't work: continue here */
@@ -219,16 +304,16 @@ static void handle_inotify_event(struct state *state, struct inotify_event *even
 			continue;
 
 		if (debug) {
-			printf("trying to reopen %s\n",
+			log_printf("trying to reopen %s\n",
 					input_file->filename);
 		}
-		reopen_input(state, i);
+		reopen_input(state, input_file);
 	}
 
 }
 
 void handle_inotify(struct state *state) {
-	int fd = state->pollfds[state->input_count].fd;
+	int fd = state->inotify.fd;
 	struct inotify_event *event;
 	/* read more at a time. Align because man page example does... */
 	char buf[4096]
@@ -260,28 +345,87 @@ static void print_key(struct input_event *event, const char *filename,
 		/* extra info pertaining previous event: don't print */
 		return;
 	case 1:
-		printf("[%ld.%03ld] %s%s%s (%d) %s: %s\n",
-		       event->input_event_sec, event->input_event_usec / 1000,
-		       debug > 2 ? filename : "",
-		       debug > 2 ? " " : "",
-		       keyname_by_code(event->code), event->code,
-		       event->value ? "pressed" : "released",
-		       message);
+		log_printf("[%ld.%03ld] %s%s%s (%d) %s: %s\n",
+			   event->input_event_sec, event->input_event_usec / 1000,
+			   debug > 2 ? filename : "",
+			   debug > 2 ? " " : "",
+			   buttond_keyname_by_code(event->code), event->code,
+			   event->value ? "pressed" : "released",
+			   message);
 		break;
 	default:
-		printf("[%ld.%03ld] %s%s%d %d %d: %s\n",
-		       event->input_event_sec, event->input_event_usec / 1000,
-		       debug > 2 ? filename : "",
-		       debug > 2 ? " " : "",
-		       event->type, event->code, event->value,
-		       message);
+		log_printf("[%ld.%03ld] %s%s%d %d %d: %s\n",
+			   event->input_event_sec, event->input_event_usec / 1000,
+			   debug > 2 ? filename : "",
+			   debug > 2 ? " " : "",
+			   event->type, event->code, event->value,
+			   message);
 	}
 }
 
 
+/* apply key events of the frame ending with report (SYN_REPORT, or
+ * last event if the frame is too long) all at its timestamp.
+ * Keys are looked up again as bindings might have changed since */
+static void handle_frame(struct state *state, struct input_file *input_file,
+			 struct input_event *report) {
+	if (virtual_time) {
+		struct timespec ts = {
+			.tv_sec = report->input_event_sec,
+			.tv_nsec = report->input_event_usec * NSECS_IN_USEC,
+		};
+		timer_advance(state, &ts);
+	}
+	for (int i = 0; i < input_file->frame_count; i++) {
+		struct input_event *event = &input_file->frame[i];
+		struct buttond_key *key = buttond_key_by_code(&state->bd, event->code);
+
+		if (!key)
+			continue;
+		event->input_event_sec = report->input_event_sec;
+		event->input_event_usec = report->input_event_usec;
+		print_key(event, input_file->filename, "processing");
+		if (state->subscriber_count || state->shmring)
+			publish_key(state, event);
+		buttond_handle_key(&state->bd, event, key, &state->now);
+	}
+	input_file->frame_count = 0;
+}
+
 static void handle_input_event(struct state *state,
 			       struct input_event *event,
-			       const char *filename) {
+			       struct input_file *input_file) {
+	const char *filename = input_file->filename;
+
+	if (event->type == EV_SYN && event->code == SYN_DROPPED) {
+		state->stats->syn_dropped++;
+		if (debug)
+			log_printf("%s: events lost, resyncing keys\n", filename);
+		input_file->syn_dropped = true;
+		input_file->frame_count = 0;
+		return;
+	}
+	if (test_mode && event->type == EV_KEY && event->code < KEY_CNT) {
+		if (event->value)
+			set_bit(input_file->test_keys, event->code);
+		else
+			clear_bit(input_file->test_keys, event->code);
+	}
+	if (event->type == EV_SYN && event->code == SYN_REPORT) {
+		/* empty after SYN_DROPPED, as that frame is incomplete */
+		handle_frame(state, input_file, event);
+		if (input_file->syn_dropped) {
+			input_file->syn_dropped = false;
+			resync_keys(state, input_file);
+		}
+		return;
+	}
+	if (input_file->syn_dropped) {
+		if (debug > 2)
+			print_key(event, filename, "ignored after SYN_DROPPED");
+		return;
+	}
+
 	/* ignore non-keyboard events */
 	if (event->type != 1) {
 		if (debug > 2)
@@ -289,45 +433,53 @@ static void handle_input_event(struct state *state,
 		return;
 	}
 
-	struct key *key = NULL;
-	for (int i = 0; i < state->key_count; i++) {
-		if (state->keys[i].code == event->code) {
-			key = &state->keys[i];
-			break;
-		}
-	}
 	/* ignore unconfigured key */
-	if (!key) {
+	if (event->code >= KEY_CNT
+	    || !is_bit_set(state->bd.key_bitmap, event->code)) {
+		state->stats->unbound_dropped++;
 		if (debug > 1)
 			print_key(event, filename, "ignored");
 		return;
 	}
-	print_key(event, filename, "processing");
 
-	handle_key(state, event, key);
+	/* keep it until SYN_REPORT */
+	if (input_file->frame_count == INPUT_FRAME_EVENTS)
+		handle_frame(state, input_file,
+			     &input_file->frame[INPUT_FRAME_EVENTS - 1]);
+	input_file->frame[input_file->frame_count++] = *event;
 }
 
 
-int handle_input(struct state *state, int i) {
-	int fd = state->pollfds[i].fd;
-	const char *filename = state->input_files[i].filename;
+/* handle n bytes of events read from input_file. Key events are kept
+ * in input_file until the SYN_REPORT ending their frame, which might
+ * come with a later read */
+int handle_input_buf(struct state *state, struct input_file *input_file,
+		     struct input_event *buf, int n) {
 	struct input_event *event;
-	char buf[4096]
-		__attribute__ ((aligned(__alignof__(*event))));
+
+	if (n % sizeof(*event) != 0) {
+		fprintf(stderr,
+			"Read something that is not a multiple of event size (%d / %zd) !? Trying to reopen\n",
+			n, sizeof(*event));
+		return -1;
+	}
+	state->stats->events_read += n / sizeof(*event);
+	for (event = buf;
+	     (char*)event + sizeof(*event) <= (char*)buf + n;
+	     event++)
+		handle_input_event(state, event, input_file);
+	return 0;
+}
+
+int handle_input(struct state *state, struct input_file *input_file) {
+	int fd = input_file->source.fd;
+	/* keep buffer a multiple of event size: evdev refuses short reads */
+	struct input_event buf[INPUT_BUF_EVENTS];
 	int n = 0;
 
 	while ((n = read_safe(fd, &buf, sizeof(buf))) > 0) {
-		if (n % sizeof(*event) != 0) {
-			fprintf(stderr,
-				"Read something that is not a multiple of event size (%d / %zd) !? Trying to reopen\n",
-				n, sizeof(*event));
+		if (handle_input_buf(state, input_file, buf, n))
 			return -1;
-		}
-		for (event = (struct input_event*)buf;
-		     (char*)event + sizeof(event) <= buf + n;
-		     event++) {
-			handle_input_event(state, event, filename);
-		}
 	}
 	if (n < 0) {
 		fprintf(stderr, "read error: %d. Trying to reopen\n", -n);
@@ -335,3 +487,54 @@ int handle_input(struct state *state, int i) {
 	}
 	return 0;
 }
+
+/* keys are about to change: handle events already queued with the
+ * bindings they were sent for. With io_uring, reads already in flight
+ * are only handled once they complete. */
+void input_drain(struct state *state) {
+#ifdef HAVE_IO_URING
+	if (state->uring)
+		return;
+#endif
+	for (int i = 0; i < state->input_count; i++) {
+		struct input_file *input_file = &state->input_files[i];
+
+		if (input_file->source.fd >= 0 && handle_input(state, input_file))
+			reopen_input(state, input_file);
+	}
+}
+
+/* keys changed from old: update event masks, and pick up newly bound
+ * keys that are already held */
+void input_reload(struct state *state, struct buttond *old) {
+	for (int i = 0; i < state->input_count; i++) {
+		struct input_file *input_file = &state->input_files[i];
+		int fd = input_file->source.fd;
+
+		if (fd < 0)
+			continue;
+		if (!test_mode)
+			set_event_mask(state, fd, input_file->filename);
+		check_pressed_keys(state, fd, old);
+	}
+}
+
+/* input_file is gone or has nothing more to give */
+void input_hangup(struct state *state, struct input_file *input_file) {
+	if (test_mode) {
+		/* exit once all inputs are done */
+		loop_del(state, &input_file->source);
+		close(input_file->source.fd);
+		input_file->source.fd = -1;
+		for (int i = 0; i < state->input_count; i++) {
+			if (state->input_files[i].source.fd >= 0)
+				return;
+		}
+		publish_flush(state);
+		exec_wait_all(state);
+		exit(0);
+	}
+	fprintf(stderr, "got HUP/ERR on %s. Trying to reopen.\n",
+		input_file->filename);
+	reopen_input(state, input_file);
+}
@@ -4,90 +4,507 @@
 #ifndef BUTTOND_KEYNAMES_H
 #define BUTTOND_KEYNAMES_H
 
+#include <stdint.h>
+
+#define NAME_NONE 0xffff
+
+struct code_name {
+	uint16_t code;
+	/* offset in strings, NAME_NONE for empty slots */
+	uint16_t name;
+};
+
+/* names of one event type's codes, without prefix (e.g. KEY_) */
+struct code_names {
+	/* all names, NUL separated */
+	const char *strings;
+	/* offset in strings of the name printed for each code */
+	const uint16_t *by_code;
+	uint16_t code_count;
+	/* perfect hash: name is in slot
+	 *   hash(name, seeds[hash(name, 0) % seed_count]) % slot_count
+	 * with hash() in keys.c */
+	const uint16_t *seeds;
+	uint16_t seed_count;
+	const struct code_name *slots;
+	uint16_t slot_count;
+};
+
+static const char key_name_strings[] =
+	"ESC\0001\0002\0003\0004\0005\0006\0007\0008\0009\0000\000"
+	"MINUS\000EQUAL\000BACKSPACE\000TAB\000Q\000W\000E\000R\000"
+	"T\000Y\000U\000I\000O\000P\000LEFTBRACE\000RIGHTBRACE\000"
+	"ENTER\000LEFTCTRL\000A\000S\000D\000F\000G\000H\000J\000K\000"
+	"L\000SEMICOLON\000APOSTROPHE\000GRAVE\000LEFTSHIFT\000"
+	"BACKSLASH\000Z\000X\000C\000V\000B\000N\000M\000COMMA\000"
+	"DOT\000SLASH\000RIGHTSHIFT\000KPASTERISK\000LEFTALT\000"
+	"SPACE\000CAPSLOCK\000F1\000F2\000F3\000F4\000F5\000F6\000"
+	"F7\000F8\000F9\000F10\000NUMLOCK\000SCROLLLOCK\000KP7\000"
+	"KP8\000KP9\000KPMINUS\000KP4\000KP5\000KP6\000KPPLUS\000"
+	"KP1\000KP2\000KP3\000KP0\000KPDOT\000ZENKAKUHANKAKU\000"
+	"102ND\000F11\000F12\000RO\000KATAKANA\000HIRAGANA\000"
+	"HENKAN\000KATAKANAHIRAGANA\000MUHENKAN\000KPJPCOMMA\000"
+	"KPENTER\000RIGHTCTRL\000KPSLASH\000SYSRQ\000RIGHTALT\000"
+	"LINEFEED\000HOME\000UP\000PAGEUP\000LEFT\000RIGHT\000END\000"
+	"DOWN\000PAGEDOWN\000INSERT\000DELETE\000MACRO\000MUTE\000"
+	"VOLUMEDOWN\000VOLUMEUP\000POWER\000KPEQUAL\000KPPLUSMINUS\000"
+	"PAUSE\000SCALE\000KPCOMMA\000HANGEUL\000HANJA\000YEN\000"
+	"LEFTMETA\000RIGHTMETA\000COMPOSE\000STOP\000AGAIN\000"
+	"PROPS\000UNDO\000FRONT\000COPY\000OPEN\000PASTE\000FIND\000"
+	"CUT\000HELP\000MENU\000CALC\000SETUP\000SLEEP\000WAKEUP\000"
+	"FILE\000SENDFILE\000DELETEFILE\000XFER\000PROG1\000PROG2\000"
+	"WWW\000MSDOS\000COFFEE\000ROTATE_DISPLAY\000CYCLEWINDOWS\000"
+	"MAIL\000BOOKMARKS\000COMPUTER\000BACK\000FORWARD\000"
+	"CLOSECD\000EJECTCD\000EJECTCLOSECD\000NEXTSONG\000"
+	"PLAYPAUSE\000PREVIOUSSONG\000STOPCD\000RECORD\000REWIND\000"
+	"PHONE\000ISO\000CONFIG\000HOMEPAGE\000REFRESH\000EXIT\000"
+	"MOVE\000EDIT\000SCROLLUP\000SCROLLDOWN\000KPLEFTPAREN\000"
+	"KPRIGHTPAREN\000NEW\000REDO\000F13\000F14\000F15\000F16\000"
+	"F17\000F18\000F19\000F20\000F21\000F22\000F23\000F24\000"
+	"PLAYCD\000PAUSECD\000PROG3\000PROG4\000ALL_APPLICATIONS\000"
+	"SUSPEND\000CLOSE\000PLAY\000FASTFORWARD\000BASSBOOST\000"
+	"PRINT\000HP\000CAMERA\000SOUND\000QUESTION\000EMAIL\000"
+	"CHAT\000SEARCH\000CONNECT\000FINANCE\000SPORT\000SHOP\000"
+	"ALTERASE\000CANCEL\000BRIGHTNESSDOWN\000BRIGHTNESSUP\000"
+	"MEDIA\000SWITCHVIDEOMODE\000KBDILLUMTOGGLE\000"
+	"KBDILLUMDOWN\000KBDILLUMUP\000SEND\000REPLY\000"
+	"FORWARDMAIL\000SAVE\000DOCUMENTS\000BATTERY\000BLUETOOTH\000"
+	"WLAN\000UWB\000UNKNOWN\000VIDEO_NEXT\000VIDEO_PREV\000"
+	"BRIGHTNESS_CYCLE\000BRIGHTNESS_AUTO\000DISPLAY_OFF\000"
+	"WWAN\000RFKILL\000MICMUTE\000OK\000SELECT\000GOTO\000"
+	"CLEAR\000POWER2\000OPTION\000INFO\000TIME\000VENDOR\000"
+	"ARCHIVE\000PROGRAM\000CHANNEL\000FAVORITES\000EPG\000PVR\000"
+	"MHP\000LANGUAGE\000TITLE\000SUBTITLE\000ANGLE\000"
+	"FULL_SCREEN\000MODE\000KEYBOARD\000ASPECT_RATIO\000PC\000"
+	"TV\000TV2\000VCR\000VCR2\000SAT\000SAT2\000CD\000TAPE\000"
+	"RADIO\000TUNER\000PLAYER\000TEXT\000DVD\000AUX\000MP3\000"
+	"AUDIO\000VIDEO\000DIRECTORY\000LIST\000MEMO\000CALENDAR\000"
+	"RED\000GREEN\000YELLOW\000BLUE\000CHANNELUP\000"
+	"CHANNELDOWN\000FIRST\000LAST\000AB\000NEXT\000RESTART\000"
+	"SLOW\000SHUFFLE\000BREAK\000PREVIOUS\000DIGITS\000TEEN\000"
+	"TWEN\000VIDEOPHONE\000GAMES\000ZOOMIN\000ZOOMOUT\000"
+	"ZOOMRESET\000WORDPROCESSOR\000EDITOR\000SPREADSHEET\000"
+	"GRAPHICSEDITOR\000PRESENTATION\000DATABASE\000NEWS\000"
+	"VOICEMAIL\000ADDRESSBOOK\000MESSENGER\000DISPLAYTOGGLE\000"
+	"SPELLCHECK\000LOGOFF\000DOLLAR\000EURO\000FRAMEBACK\000"
+	"FRAMEFORWARD\000CONTEXT_MENU\000MEDIA_REPEAT\000"
+	"10CHANNELSUP\00010CHANNELSDOWN\000IMAGES\000"
+	"NOTIFICATION_CENTER\000PICKUP_PHONE\000HANGUP_PHONE\000"
+	"LINK_PHONE\000DEL_EOL\000DEL_EOS\000INS_LINE\000DEL_LINE\000"
+	"FN\000FN_ESC\000FN_F1\000FN_F2\000FN_F3\000FN_F4\000FN_F5\000"
+	"FN_F6\000FN_F7\000FN_F8\000FN_F9\000FN_F10\000FN_F11\000"
+	"FN_F12\000FN_1\000FN_2\000FN_D\000FN_E\000FN_F\000FN_S\000"
+	"FN_B\000FN_RIGHT_SHIFT\000BRL_DOT1\000BRL_DOT2\000"
+	"BRL_DOT3\000BRL_DOT4\000BRL_DOT5\000BRL_DOT6\000BRL_DOT7\000"
+	"BRL_DOT8\000BRL_DOT9\000BRL_DOT10\000NUMERIC_0\000"
+	"NUMERIC_1\000NUMERIC_2\000NUMERIC_3\000NUMERIC_4\000"
+	"NUMERIC_5\000NUMERIC_6\000NUMERIC_7\000NUMERIC_8\000"
+	"NUMERIC_9\000NUMERIC_STAR\000NUMERIC_POUND\000NUMERIC_A\000"
+	"NUMERIC_B\000NUMERIC_C\000NUMERIC_D\000CAMERA_FOCUS\000"
+	"WPS_BUTTON\000TOUCHPAD_TOGGLE\000TOUCHPAD_ON\000"
+	"TOUCHPAD_OFF\000CAMERA_ZOOMIN\000CAMERA_ZOOMOUT\000"
+	"CAMERA_UP\000CAMERA_DOWN\000CAMERA_LEFT\000CAMERA_RIGHT\000"
+	"ATTENDANT_ON\000ATTENDANT_OFF\000ATTENDANT_TOGGLE\000"
+	"LIGHTS_TOGGLE\000ALS_TOGGLE\000ROTATE_LOCK_TOGGLE\000"
+	"REFRESH_RATE_TOGGLE\000BUTTONCONFIG\000TASKMANAGER\000"
+	"JOURNAL\000CONTROLPANEL\000APPSELECT\000SCREENSAVER\000"
+	"VOICECOMMAND\000ASSISTANT\000KBD_LAYOUT_NEXT\000"
+	"EMOJI_PICKER\000DICTATE\000BRIGHTNESS_MIN\000"
+	"BRIGHTNESS_MAX\000KBDINPUTASSIST_PREV\000"
+	"KBDINPUTASSIST_NEXT\000KBDINPUTASSIST_PREVGROUP\000"
+	"KBDINPUTASSIST_NEXTGROUP\000KBDINPUTASSIST_ACCEPT\000"
+	"KBDINPUTASSIST_CANCEL\000RIGHT_UP\000RIGHT_DOWN\000"
+	"LEFT_UP\000LEFT_DOWN\000ROOT_MENU\000MEDIA_TOP_MENU\000"
+	"NUMERIC_11\000NUMERIC_12\000AUDIO_DESC\0003D_MODE\000"
+	"NEXT_FAVORITE\000STOP_RECORD\000PAUSE_RECORD\000VOD\000"
+	"UNMUTE\000FASTREVERSE\000SLOWREVERSE\000DATA\000"
+	"ONSCREEN_KEYBOARD\000PRIVACY_SCREEN_TOGGLE\000"
+	"SELECTIVE_SCREENSHOT\000NEXT_ELEMENT\000PREVIOUS_ELEMENT\000"
+	"AUTOPILOT_ENGAGE_TOGGLE\000MARK_WAYPOINT\000SOS\000"
+	"NAV_CHART\000FISHING_CHART\000SINGLE_RANGE_RADAR\000"
+	"DUAL_RANGE_RADAR\000RADAR_OVERLAY\000TRADITIONAL_SONAR\000"
+	"CLEARVU_SONAR\000SIDEVU_SONAR\000NAV_INFO\000"
+	"BRIGHTNESS_MENU\000MACRO1\000MACRO2\000MACRO3\000MACRO4\000"
+	"MACRO5\000MACRO6\000MACRO7\000MACRO8\000MACRO9\000MACRO10\000"
+	"MACRO11\000MACRO12\000MACRO13\000MACRO14\000MACRO15\000"
+	"MACRO16\000MACRO17\000MACRO18\000MACRO19\000MACRO20\000"
+	"MACRO21\000MACRO22\000MACRO23\000MACRO24\000MACRO25\000"
+	"MACRO26\000MACRO27\000MACRO28\000MACRO29\000MACRO30\000"
+	"MACRO_RECORD_START\000MACRO_RECORD_STOP\000"
+	"MACRO_PRESET_CYCLE\000MACRO_PRESET1\000MACRO_PRESET2\000"
+	"MACRO_PRESET3\000KBD_LCD_MENU1\000KBD_LCD_MENU2\000"
+	"KBD_LCD_MENU3\000KBD_LCD_MENU4\000KBD_LCD_MENU5\000";
+
+static const uint16_t key_name_by_code[701] = {
+	NAME_NONE, 0, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 30, 
+	36, 46, 50, 52, 54, 56, 58, 60, 62, 64, 66, 68, 70, 80, 91, 
+	97, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 134, 
+	145, 151, 161, 171, 173, 175, 177, 179, 181, 183, 185, 191, 
+	195, 201, 212, 223, 231, 237, 246, 249, 252, 255, 258, 261, 
+	264, 267, 270, 273, 277, 285, 296, 300, 304, 308, 316, 320, 
+	324, 328, 335, 339, 343, 347, 351, NAME_NONE, 357, 372, 378, 
+	382, 386, 389, 398, 407, 414, 431, 440, 450, 458, 468, 476, 
+	482, 491, 500, 505, 508, 515, 520, 526, 530, 535, 544, 551, 
+	558, 564, 569, 580, 589, 595, 603, 615, 621, 627, 635, 643, 
+	649, 653, 662, 672, 680, 685, 691, 697, 702, 708, 713, 718, 
+	724, 729, 733, 738, 743, 748, 754, 760, 767, 772, 781, 792, 
+	797, 803, 809, 813, 819, 826, 841, 854, 859, 869, 878, 883, 
+	891, 899, 907, 920, 929, 939, 952, 959, 966, 973, 979, 983, 
+	990, 999, 1007, 1012, 1017, 1022, 1031, 1042, 1054, 1067, 
+	1071, 1076, 1080, 1084, 1088, 1092, 1096, 1100, 1104, 1108, 
+	1112, 1116, 1120, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, 1124, 1131, 1139, 1145, 1151, 1168, 1176, 1182, 
+	1187, 1199, 1209, 1215, 1218, 1225, 1231, 1240, 1246, 1251, 
+	1258, 1266, 1274, 1280, 1285, 1294, 1301, 1316, 1329, 1335, 
+	1351, 1366, 1379, 1390, 1395, 1401, 1413, 1418, 1428, 1436, 
+	1446, 1451, 1455, 1463, 1474, 1485, 1502, 1518, 1530, 1535, 
+	1542, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, 1550, 1553, 1560, 1565, 
+	1571, 1578, 1585, 1590, 1595, 1602, 1610, 1618, 1626, 1636, 
+	1640, 1644, 1648, 1657, 1663, 1672, 1678, 1690, 1695, 1704, 
+	1717, 1720, 1723, 1727, 1731, 1736, 1740, 1745, 1748, 1753, 
+	1759, 1765, 1772, 1777, 1781, 1785, 1789, 1795, 1801, 1811, 
+	1816, 1821, 1830, 1834, 1840, 1847, 1852, 1862, 1874, 1880, 
+	1885, 1888, 1893, 1901, 1906, 1914, 1920, 1929, 1936, 1941, 
+	1946, 1957, 1963, 1970, 1978, 1988, 2002, 2009, 2021, 2036, 
+	2049, 2058, 2063, 2073, 2085, 2095, 2109, 2120, 2127, 2134, 
+	2139, 2149, 2162, 2175, 2188, 2201, 2216, NAME_NONE, 2223, 
+	2243, 2256, 2269, 2280, 2288, 2296, 2305, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, 2314, 2317, 2324, 2330, 2336, 2342, 2348, 2354, 
+	2360, 2366, 2372, 2378, 2385, 2392, 2399, 2404, 2409, 2414, 
+	2419, 2424, 2429, 2434, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, 2449, 2458, 2467, 2476, 
+	2485, 2494, 2503, 2512, 2521, 2530, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, 2540, 2550, 2560, 2570, 
+	2580, 2590, 2600, 2610, 2620, 2630, 2640, 2653, 2667, 2677, 
+	2687, 2697, 2707, 2720, 2731, 2747, 2759, 2772, 2786, 2801, 
+	2811, 2823, 2835, 2848, 2861, 2875, 2892, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, 2906, 2917, 2936, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 2956, 
+	2969, 2981, 2989, 3002, 3012, 3024, 3037, 3047, 3063, 3076, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 3084, 
+	3099, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 3114, 3134, 3154, 
+	3179, 3204, 3226, 3248, 3257, 3268, 3276, 3286, 3296, 3311, 
+	3322, 3333, 3344, 3352, 3366, 3378, 3391, 3395, 3402, 3414, 
+	3426, 3431, 3449, 3471, 3492, 3505, 3522, 3546, 3560, 3564, 
+	3574, 3588, 3607, 3624, 3638, 3656, 3670, 3683, 3692, 
+	NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, 3708, 3715, 3722, 3729, 3736, 3743, 3750, 3757, 
+	3764, 3771, 3779, 3787, 3795, 3803, 3811, 3819, 3827, 3835, 
+	3843, 3851, 3859, 3867, 3875, 3883, 3891, 3899, 3907, 3915, 
+	3923, 3931, NAME_NONE, NAME_NONE, 3939, 3958, 3976, 3995, 
+	4009, 4023, NAME_NONE, NAME_NONE, 4037, 4051, 4065, 4079, 
+	4093, 
+};
+
+static const uint16_t key_name_seeds[126] = {
+	4, 18, 19, 34, 3, 11, 1, 13, 0, 11, 33, 1, 12, 12, 2, 1, 3, 
+	31, 1, 34, 21, 15, 2, 19, 97, 5, 3, 21, 1, 2, 4, 9, 13, 2, 8, 
+	10, 11, 5, 121, 1, 7, 1, 17, 1, 1, 1, 1, 6, 9, 1, 7, 16, 47, 
+	53, 41, 9, 1, 1, 9, 3, 7, 8, 3, 21, 3, 4, 26, 4, 20, 1, 6, 
+	100, 15, 35, 22, 15, 2, 5, 1, 50, 8, 1, 47, 6, 42, 32, 3, 6, 
+	28, 2, 79, 51, 8, 43, 8, 4, 6, 12, 2, 0, 1, 18, 15, 1, 5, 66, 
+	4, 17, 23, 9, 57, 0, 19, 2, 7, 15, 144, 18, 36, 5, 20, 22, 
+	107, 4, 1, 29, 
+};
+
+static const struct code_name key_name_slots[629] = {
+	{ 170, 979 }, { 0, NAME_NONE }, { 59, 246 }, 
+	{ 0, NAME_NONE }, { 95, 440 }, { 111, 551 }, { 57, 231 }, 
+	{ 0, NAME_NONE }, { 45, 173 }, { 394, 1801 }, 
+	{ 0, NAME_NONE }, { 413, 1929 }, { 393, 1795 }, 
+	{ 0, NAME_NONE }, { 12, 24 }, { 145, 772 }, { 375, 1704 }, 
+	{ 512, 2540 }, { 473, 2366 }, { 674, 3843 }, 
+	{ 0, NAME_NONE }, { 583, 3037 }, { 179, 1042 }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 578, 2981 }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 368, 1648 }, 
+	{ 374, 1695 }, { 0, NAME_NONE }, { 389, 1777 }, 
+	{ 0, NAME_NONE }, { 664, 3764 }, { 125, 653 }, { 78, 328 }, 
+	{ 361, 1602 }, { 427, 2058 }, { 644, 3624 }, 
+	{ 0, NAME_NONE }, { 189, 1100 }, { 0, NAME_NONE }, 
+	{ 585, 3063 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 152, 819 }, { 54, 201 }, { 388, 1772 }, { 629, 3402 }, 
+	{ 562, 2936 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 403, 1862 }, { 166, 952 }, { 0, NAME_NONE }, { 425, 2036 }, 
+	{ 619, 3296 }, { 182, 1071 }, { 386, 1759 }, { 162, 907 }, 
+	{ 127, 672 }, { 657, 3715 }, { 0, NAME_NONE }, { 659, 3729 }, 
+	{ 660, 3736 }, { 661, 3743 }, { 662, 3750 }, { 523, 2653 }, 
+	{ 116, 589 }, { 236, 1428 }, { 442, 2216 }, { 435, 2134 }, 
+	{ 149, 803 }, { 101, 491 }, { 203, 1145 }, { 222, 1285 }, 
+	{ 616, 3268 }, { 51, 185 }, { 213, 1225 }, { 424, 2021 }, 
+	{ 241, 1463 }, { 244, 1502 }, { 2, 4 }, { 237, 1436 }, 
+	{ 663, 3757 }, { 123, 643 }, { 464, 2314 }, { 117, 595 }, 
+	{ 0, NAME_NONE }, { 9, 18 }, { 10, 20 }, { 224, 1301 }, 
+	{ 180, 1054 }, { 364, 1626 }, { 209, 1199 }, { 445, 2243 }, 
+	{ 231, 1390 }, { 0, NAME_NONE }, { 378, 1723 }, 
+	{ 609, 3134 }, { 181, 1067 }, { 0, NAME_NONE }, { 18, 54 }, 
+	{ 177, 1022 }, { 0, NAME_NONE }, { 29, 97 }, { 1, 0 }, 
+	{ 356, 1571 }, { 0, NAME_NONE }, { 172, 990 }, { 579, 2989 }, 
+	{ 49, 181 }, { 451, 2305 }, { 676, 3859 }, { 16, 50 }, 
+	{ 698, 4065 }, { 679, 3883 }, { 0, NAME_NONE }, 
+	{ 681, 3899 }, { 28, 91 }, { 169, 973 }, { 580, 3002 }, 
+	{ 577, 2969 }, { 354, 1560 }, { 392, 1789 }, { 479, 2404 }, 
+	{ 581, 3012 }, { 214, 1231 }, { 13, 30 }, { 27, 80 }, 
+	{ 430, 2085 }, { 163, 920 }, { 15, 46 }, { 0, NAME_NONE }, 
+	{ 665, 3771 }, { 505, 2521 }, { 647, 3670 }, { 420, 1978 }, 
+	{ 537, 2823 }, { 234, 1413 }, { 429, 2073 }, { 381, 1736 }, 
+	{ 447, 2269 }, { 94, 431 }, { 608, 3114 }, { 235, 1418 }, 
+	{ 38, 122 }, { 0, NAME_NONE }, { 656, 3708 }, { 501, 2485 }, 
+	{ 670, 3811 }, { 503, 2503 }, { 0, NAME_NONE }, 
+	{ 419, 1970 }, { 0, NAME_NONE }, { 99, 476 }, { 83, 351 }, 
+	{ 432, 2109 }, { 630, 3414 }, { 21, 60 }, { 524, 2667 }, 
+	{ 82, 347 }, { 153, 826 }, { 527, 2697 }, { 561, 2917 }, 
+	{ 75, 316 }, { 0, NAME_NONE }, { 539, 2848 }, { 71, 296 }, 
+	{ 390, 1781 }, { 138, 733 }, { 380, 1731 }, { 439, 2175 }, 
+	{ 377, 1720 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 617, 3276 }, { 108, 530 }, { 215, 1240 }, { 683, 3915 }, 
+	{ 465, 2317 }, { 90, 389 }, { 623, 3344 }, { 225, 1316 }, 
+	{ 58, 237 }, { 638, 3546 }, { 352, 1550 }, { 191, 1108 }, 
+	{ 0, NAME_NONE }, { 611, 3179 }, { 440, 2188 }, 
+	{ 405, 1880 }, { 132, 702 }, { 376, 1717 }, { 483, 2424 }, 
+	{ 118, 603 }, { 0, NAME_NONE }, { 47, 177 }, { 42, 151 }, 
+	{ 396, 1816 }, { 103, 505 }, { 627, 3391 }, { 89, 386 }, 
+	{ 689, 3958 }, { 56, 223 }, { 499, 2467 }, { 433, 2120 }, 
+	{ 143, 760 }, { 0, NAME_NONE }, { 74, 308 }, { 535, 2801 }, 
+	{ 85, 357 }, { 680, 3891 }, { 0, NAME_NONE }, { 373, 1690 }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 450, 2296 }, { 688, 3939 }, { 384, 1748 }, { 30, 106 }, 
+	{ 669, 3803 }, { 46, 175 }, { 160, 891 }, { 174, 1007 }, 
+	{ 140, 743 }, { 0, NAME_NONE }, { 92, 407 }, { 200, 1124 }, 
+	{ 32, 110 }, { 205, 1168 }, { 113, 564 }, { 39, 124 }, 
+	{ 481, 2414 }, { 157, 869 }, { 100, 482 }, { 528, 2707 }, 
+	{ 576, 2956 }, { 645, 3638 }, { 0, NAME_NONE }, 
+	{ 641, 3574 }, { 696, 4037 }, { 0, NAME_NONE }, { 106, 520 }, 
+	{ 0, NAME_NONE }, { 158, 878 }, { 421, 1988 }, 
+	{ 0, NAME_NONE }, { 541, 2875 }, { 612, 3204 }, { 156, 859 }, 
+	{ 226, 1329 }, { 0, NAME_NONE }, { 422, 2002 }, 
+	{ 529, 2720 }, { 0, NAME_NONE }, { 62, 255 }, 
+	{ 0, NAME_NONE }, { 362, 1610 }, { 632, 3431 }, 
+	{ 402, 1852 }, { 0, NAME_NONE }, { 221, 1280 }, 
+	{ 357, 1578 }, { 476, 2385 }, { 5, 10 }, { 675, 3851 }, 
+	{ 446, 2256 }, { 633, 3449 }, { 353, 1553 }, { 359, 1590 }, 
+	{ 0, NAME_NONE }, { 208, 1187 }, { 247, 1535 }, 
+	{ 383, 1745 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 624, 3352 }, { 69, 277 }, { 26, 70 }, { 0, NAME_NONE }, 
+	{ 50, 183 }, { 14, 36 }, { 7, 14 }, { 207, 1182 }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 449, 2288 }, 
+	{ 700, 4093 }, { 150, 809 }, { 0, NAME_NONE }, { 165, 939 }, 
+	{ 593, 3099 }, { 0, NAME_NONE }, { 176, 1017 }, { 19, 56 }, 
+	{ 431, 2095 }, { 401, 1847 }, { 426, 2049 }, 
+	{ 0, NAME_NONE }, { 187, 1092 }, { 204, 1151 }, 
+	{ 625, 3366 }, { 60, 249 }, { 218, 1258 }, { 114, 569 }, 
+	{ 63, 258 }, { 367, 1644 }, { 639, 3560 }, { 238, 1446 }, 
+	{ 131, 697 }, { 173, 999 }, { 407, 1888 }, { 227, 1335 }, 
+	{ 0, NAME_NONE }, { 136, 724 }, { 635, 3492 }, { 385, 1753 }, 
+	{ 0, NAME_NONE }, { 506, 2530 }, { 65, 264 }, { 634, 3471 }, 
+	{ 382, 1740 }, { 0, NAME_NONE }, { 470, 2348 }, 
+	{ 0, NAME_NONE }, { 194, 1120 }, { 33, 112 }, { 144, 767 }, 
+	{ 64, 261 }, { 217, 1251 }, { 212, 1218 }, { 0, NAME_NONE }, 
+	{ 423, 2009 }, { 142, 754 }, { 631, 3426 }, { 48, 179 }, 
+	{ 542, 2892 }, { 24, 66 }, { 0, NAME_NONE }, { 31, 108 }, 
+	{ 130, 691 }, { 637, 3522 }, { 0, NAME_NONE }, { 17, 52 }, 
+	{ 86, 372 }, { 0, NAME_NONE }, { 216, 1246 }, 
+	{ 0, NAME_NONE }, { 615, 3257 }, { 0, NAME_NONE }, 
+	{ 398, 1830 }, { 93, 414 }, { 466, 2324 }, { 467, 2330 }, 
+	{ 640, 3564 }, { 115, 580 }, { 35, 116 }, { 0, NAME_NONE }, 
+	{ 610, 3154 }, { 37, 120 }, { 0, NAME_NONE }, { 229, 1366 }, 
+	{ 658, 3722 }, { 3, 6 }, { 692, 4009 }, { 365, 1636 }, 
+	{ 151, 813 }, { 530, 2731 }, { 0, NAME_NONE }, { 77, 324 }, 
+	{ 139, 738 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 502, 2494 }, { 141, 748 }, { 192, 1112 }, { 471, 2354 }, 
+	{ 582, 3024 }, { 693, 4023 }, { 175, 1012 }, { 107, 526 }, 
+	{ 161, 899 }, { 119, 615 }, { 414, 1936 }, { 76, 320 }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 186, 1088 }, { 668, 3795 }, { 0, NAME_NONE }, 
+	{ 437, 2149 }, { 372, 1678 }, { 6, 12 }, { 87, 378 }, 
+	{ 444, 2223 }, { 536, 2811 }, { 43, 161 }, { 211, 1215 }, 
+	{ 73, 304 }, { 0, NAME_NONE }, { 532, 2759 }, 
+	{ 0, NAME_NONE }, { 171, 983 }, { 0, NAME_NONE }, 
+	{ 418, 1963 }, { 0, NAME_NONE }, { 514, 2560 }, 
+	{ 223, 1294 }, { 122, 635 }, { 210, 1209 }, { 0, NAME_NONE }, 
+	{ 513, 2550 }, { 243, 1485 }, { 515, 2570 }, { 434, 2127 }, 
+	{ 517, 2590 }, { 518, 2600 }, { 519, 2610 }, { 520, 2620 }, 
+	{ 408, 1893 }, { 0, NAME_NONE }, { 667, 3787 }, 
+	{ 475, 2378 }, { 370, 1663 }, { 646, 3656 }, { 671, 3819 }, 
+	{ 129, 685 }, { 4, 8 }, { 525, 2677 }, { 526, 2687 }, 
+	{ 0, NAME_NONE }, { 682, 3907 }, { 0, NAME_NONE }, 
+	{ 684, 3923 }, { 98, 468 }, { 124, 649 }, { 0, NAME_NONE }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 164, 929 }, 
+	{ 146, 781 }, { 649, 3692 }, { 428, 2063 }, { 677, 3867 }, 
+	{ 228, 1351 }, { 230, 1379 }, { 497, 2449 }, { 415, 1941 }, 
+	{ 0, NAME_NONE }, { 391, 1785 }, { 25, 68 }, { 691, 3995 }, 
+	{ 121, 627 }, { 469, 2342 }, { 0, NAME_NONE }, { 202, 1139 }, 
+	{ 472, 2360 }, { 23, 64 }, { 474, 2372 }, { 614, 3248 }, 
+	{ 36, 118 }, { 40, 134 }, { 533, 2772 }, { 436, 2139 }, 
+	{ 399, 1834 }, { 206, 1176 }, { 0, NAME_NONE }, 
+	{ 0, NAME_NONE }, { 540, 2861 }, { 0, NAME_NONE }, 
+	{ 0, NAME_NONE }, { 240, 1455 }, { 96, 450 }, { 584, 3047 }, 
+	{ 355, 1565 }, { 404, 1874 }, { 538, 2835 }, { 448, 2280 }, 
+	{ 201, 1131 }, { 0, NAME_NONE }, { 112, 558 }, { 411, 1914 }, 
+	{ 0, NAME_NONE }, { 11, 22 }, { 104, 508 }, { 666, 3779 }, 
+	{ 685, 3931 }, { 0, NAME_NONE }, { 673, 3835 }, 
+	{ 0, NAME_NONE }, { 8, 16 }, { 0, NAME_NONE }, { 417, 1957 }, 
+	{ 97, 458 }, { 412, 1920 }, { 128, 680 }, { 155, 854 }, 
+	{ 120, 621 }, { 621, 3322 }, { 0, NAME_NONE }, { 67, 270 }, 
+	{ 560, 2906 }, { 406, 1885 }, { 61, 252 }, { 0, NAME_NONE }, 
+	{ 20, 58 }, { 648, 3683 }, { 248, 1542 }, { 613, 3226 }, 
+	{ 0, NAME_NONE }, { 480, 2409 }, { 531, 2747 }, { 105, 515 }, 
+	{ 148, 797 }, { 642, 3588 }, { 0, NAME_NONE }, { 366, 1640 }, 
+	{ 147, 792 }, { 363, 1618 }, { 0, NAME_NONE }, { 41, 145 }, 
+	{ 34, 114 }, { 441, 2201 }, { 245, 1518 }, { 620, 3311 }, 
+	{ 0, NAME_NONE }, { 126, 662 }, { 0, NAME_NONE }, 
+	{ 672, 3827 }, { 79, 335 }, { 80, 339 }, { 0, NAME_NONE }, 
+	{ 246, 1530 }, { 133, 708 }, { 387, 1765 }, { 478, 2399 }, 
+	{ 178, 1031 }, { 477, 2392 }, { 220, 1274 }, { 55, 212 }, 
+	{ 91, 398 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 618, 3286 }, { 438, 2162 }, { 232, 1395 }, { 159, 883 }, 
+	{ 498, 2458 }, { 44, 171 }, { 500, 2476 }, { 360, 1595 }, 
+	{ 0, NAME_NONE }, { 484, 2429 }, { 400, 1840 }, 
+	{ 534, 2786 }, { 0, NAME_NONE }, { 482, 2419 }, 
+	{ 369, 1657 }, { 636, 3505 }, { 395, 1811 }, { 416, 1946 }, 
+	{ 0, NAME_NONE }, { 371, 1672 }, { 233, 1401 }, 
+	{ 0, NAME_NONE }, { 70, 285 }, { 0, NAME_NONE }, 
+	{ 522, 2640 }, { 0, NAME_NONE }, { 154, 841 }, { 72, 300 }, 
+	{ 678, 3875 }, { 0, NAME_NONE }, { 0, NAME_NONE }, 
+	{ 409, 1901 }, { 0, NAME_NONE }, { 81, 343 }, { 622, 3333 }, 
+	{ 190, 1104 }, { 586, 3076 }, { 0, NAME_NONE }, 
+	{ 193, 1116 }, { 219, 1266 }, { 521, 2630 }, { 242, 1474 }, 
+	{ 379, 1727 }, { 626, 3378 }, { 468, 2336 }, { 410, 1906 }, 
+	{ 102, 500 }, { 690, 3976 }, { 516, 2580 }, { 110, 544 }, 
+	{ 504, 2512 }, { 0, NAME_NONE }, { 66, 267 }, { 52, 191 }, 
+	{ 134, 713 }, { 168, 966 }, { 0, NAME_NONE }, 
+	{ 0, NAME_NONE }, { 239, 1451 }, { 109, 535 }, { 22, 62 }, 
+	{ 167, 959 }, { 643, 3607 }, { 68, 273 }, { 397, 1821 }, 
+	{ 88, 382 }, { 183, 1076 }, { 184, 1080 }, { 185, 1084 }, 
+	{ 0, NAME_NONE }, { 592, 3084 }, { 188, 1096 }, { 135, 718 }, 
+	{ 697, 4051 }, { 628, 3395 }, { 699, 4079 }, { 485, 2434 }, 
+	{ 53, 195 }, { 358, 1585 }, { 137, 729 }, 
+};
+
+static const struct code_names key_names = {
+	.strings = key_name_strings,
+	.by_code = key_name_by_code,
+	.code_count = 701,
+	.seeds = key_name_seeds,
+	.seed_count = 126,
+	.slots = key_name_slots,
+	.slot_count = 629,
+};
+
+static const char sw_name_strings[] =
+	"LID\000TABLET_MODE\000HEADPHONE_INSERT\000RFKILL_ALL\000"
+	"MICROPHONE_INSERT\000DOCK\000LINEOUT_INSERT\000"
+	"JACK_PHYSICAL_INSERT\000VIDEOOUT_INSERT\000"
+	"CAMERA_LENS_COVER\000KEYPAD_SLIDE\000FRONT_PROXIMITY\000"
+	"ROTATE_LOCK\000LINEIN_INSERT\000MUTE_DEVICE\000"
+	"PEN_INSERTED\000MACHINE_COVER\000";
+
+static const uint16_t sw_name_by_code[17] = {
+	0, 4, 16, 33, 44, 62, 67, 82, 103, 119, 137, 150, 166, 178, 
+	192, 204, 217, 
+};
+
+static const uint16_t sw_name_seeds[5] = {
+	8, 2, 1, 12, 8, 
+};
+
+static const struct code_name sw_name_slots[22] = {
+	{ 7, 82 }, { 4, 44 }, { 0, 0 }, { 10, 137 }, 
+	{ 0, NAME_NONE }, { 11, 150 }, { 9, 119 }, { 16, 217 }, 
+	{ 12, 166 }, { 2, 16 }, { 13, 178 }, { 3, 33 }, { 6, 67 }, 
+	{ 0, NAME_NONE }, { 0, NAME_NONE }, { 1, 4 }, { 14, 192 }, 
+	{ 5, 62 }, { 0, NAME_NONE }, { 15, 204 }, { 0, NAME_NONE }, 
+	{ 8, 103 }, 
+};
+
+static const struct code_names sw_names = {
+	.strings = sw_name_strings,
+	.by_code = sw_name_by_code,
+	.code_count = 17,
+	.seeds = sw_name_seeds,
+	.seed_count = 5,
+	.slots = sw_name_slots,
+	.slot_count = 22,
+};
+
+static const char abs_name_strings[] =
+	"X\000Y\000Z\000RX\000RY\000RZ\000THROTTLE\000RUDDER\000"
+	"WHEEL\000GAS\000BRAKE\000HAT0X\000HAT0Y\000HAT1X\000HAT1Y\000"
+	"HAT2X\000HAT2Y\000HAT3X\000HAT3Y\000PRESSURE\000DISTANCE\000"
+	"TILT_X\000TILT_Y\000TOOL_WIDTH\000VOLUME\000PROFILE\000"
+	"MISC\000RESERVED\000MT_SLOT\000MT_TOUCH_MAJOR\000"
+	"MT_TOUCH_MINOR\000MT_WIDTH_MAJOR\000MT_WIDTH_MINOR\000"
+	"MT_ORIENTATION\000MT_POSITION_X\000MT_POSITION_Y\000"
+	"MT_TOOL_TYPE\000MT_BLOB_ID\000MT_TRACKING_ID\000"
+	"MT_PRESSURE\000MT_DISTANCE\000MT_TOOL_X\000MT_TOOL_Y\000";
+
+static const uint16_t abs_name_by_code[62] = {
+	0, 2, 4, 6, 9, 12, 15, 24, 31, 37, 41, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, NAME_NONE, 47, 53, 59, 65, 71, 77, 83, 
+	89, 95, 104, 113, 120, 127, NAME_NONE, NAME_NONE, NAME_NONE, 
+	138, 145, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, 153, NAME_NONE, NAME_NONE, NAME_NONE, 
+	NAME_NONE, NAME_NONE, 158, 167, 175, 190, 205, 220, 235, 250, 
+	264, 278, 291, 302, 317, 329, 341, 351, 
+};
+
+static const uint16_t abs_name_seeds[11] = {
+	21, 11, 1, 1, 14, 2, 5, 27, 24, 5, 8, 
+};
+
+static const struct code_name abs_name_slots[54] = {
+	{ 0, NAME_NONE }, { 0, 0 }, { 58, 317 }, { 49, 190 }, 
+	{ 23, 89 }, { 51, 220 }, { 0, NAME_NONE }, { 55, 278 }, 
+	{ 0, NAME_NONE }, { 60, 341 }, { 61, 351 }, { 25, 104 }, 
+	{ 20, 71 }, { 24, 95 }, { 28, 127 }, { 2, 4 }, { 52, 235 }, 
+	{ 3, 6 }, { 21, 77 }, { 53, 250 }, { 32, 138 }, { 6, 15 }, 
+	{ 56, 291 }, { 27, 120 }, { 1, 2 }, { 22, 83 }, { 48, 175 }, 
+	{ 40, 153 }, { 0, NAME_NONE }, { 17, 53 }, { 0, NAME_NONE }, 
+	{ 54, 264 }, { 19, 65 }, { 10, 41 }, { 0, NAME_NONE }, 
+	{ 7, 24 }, { 9, 37 }, { 8, 31 }, { 46, 158 }, 
+	{ 0, NAME_NONE }, { 33, 145 }, { 0, NAME_NONE }, { 59, 329 }, 
+	{ 0, NAME_NONE }, { 26, 113 }, { 18, 59 }, { 0, NAME_NONE }, 
+	{ 47, 167 }, { 50, 205 }, { 0, NAME_NONE }, { 4, 9 }, 
+	{ 5, 12 }, { 16, 47 }, { 57, 302 }, 
+};
+
+static const struct code_names abs_names = {
+	.strings = abs_name_strings,
+	.by_code = abs_name_by_code,
+	.code_count = 62,
+	.seeds = abs_name_seeds,
+	.seed_count = 11,
+	.slots = abs_name_slots,
+	.slot_count = 54,
+};
 
-const char allkeynames[] =
-  "ESC\0001\0002\0003\0004\0005\0006\0007\0008\0009\0000\000MINUS\000"
-  "EQUAL\000BACKSPACE\000TAB\000Q\000W\000E\000R\000T\000Y\000U\000I\000O\000"
-  "P\000LEFTBRACE\000RIGHTBRACE\000ENTER\000LEFTCTRL\000A\000S\000D\000F\000"
-  "G\000H\000J\000K\000L\000SEMICOLON\000APOSTROPHE\000GRAVE\000"
-  "LEFTSHIFT\000BACKSLASH\000Z\000X\000C\000V\000B\000N\000M\000COMMA\000DOT\000"
-  "SLASH\000RIGHTSHIFT\000KPASTERISK\000LEFTALT\000SPACE\000CAPSLOCK\000F1\000"
-  "F2\000F3\000F4\000F5\000F6\000F7\000F8\000F9\000F10\000NUMLOCK\000"
-  "SCROLLLOCK\000KP7\000KP8\000KP9\000KPMINUS\000KP4\000KP5\000KP6\000KPPLUS\000"
-  "KP1\000KP2\000KP3\000KP0\000KPDOT\000\000ZENKAKUHANKAKU\000102ND\000F11\000"
-  "F12\000RO\000KATAKANA\000HIRAGANA\000HENKAN\000KATAKANAHIRAGANA\000"
-  "MUHENKAN\000KPJPCOMMA\000KPENTER\000RIGHTCTRL\000KPSLASH\000SYSRQ\000"
-  "RIGHTALT\000LINEFEED\000HOME\000UP\000PAGEUP\000LEFT\000RIGHT\000END\000DOWN\000"
-  "PAGEDOWN\000INSERT\000DELETE\000MACRO\000MUTE\000VOLUMEDOWN\000VOLUMEUP\000"
-  "POWER\000KPEQUAL\000KPPLUSMINUS\000PAUSE\000SCALE\000KPCOMMA\000HANGEUL\000"
-  "HANJA\000YEN\000LEFTMETA\000RIGHTMETA\000COMPOSE\000STOP\000AGAIN\000"
-  "PROPS\000UNDO\000FRONT\000COPY\000OPEN\000PASTE\000FIND\000CUT\000HELP\000"
-  "MENU\000CALC\000SETUP\000SLEEP\000WAKEUP\000FILE\000SENDFILE\000"
-  "DELETEFILE\000XFER\000PROG1\000PROG2\000WWW\000MSDOS\000COFFEE\000"
-  "ROTATE_DISPLAY\000CYCLEWINDOWS\000MAIL\000BOOKMARKS\000COMPUTER\000BACK\000FORWARD\000"
-  "CLOSECD\000EJECTCD\000EJECTCLOSECD\000NEXTSONG\000PLAYPAUSE\000PREVIOUSSONG\000"
-  "STOPCD\000RECORD\000REWIND\000PHONE\000ISO\000CONFIG\000HOMEPAGE\000"
-  "REFRESH\000EXIT\000MOVE\000EDIT\000SCROLLUP\000SCROLLDOWN\000KPLEFTPAREN\000"
-  "KPRIGHTPAREN\000NEW\000REDO\000F13\000F14\000F15\000F16\000F17\000F18\000F19\000"
-  "F20\000F21\000F22\000F23\000F24\000\000\000\000\000\000PLAYCD\000"
-  "PAUSECD\000PROG3\000PROG4\000DASHBOARD\000SUSPEND\000CLOSE\000PLAY\000"
-  "FASTFORWARD\000BASSBOOST\000PRINT\000HP\000CAMERA\000SOUND\000QUESTION\000EMAIL\000"
-  "CHAT\000SEARCH\000CONNECT\000FINANCE\000SPORT\000SHOP\000ALTERASE\000"
-  "CANCEL\000BRIGHTNESSDOWN\000BRIGHTNESSUP\000MEDIA\000SWITCHVIDEOMODE\000"
-  "KBDILLUMTOGGLE\000KBDILLUMDOWN\000KBDILLUMUP\000SEND\000REPLY\000FORWARDMAIL\000"
-  "SAVE\000DOCUMENTS\000BATTERY\000BLUETOOTH\000WLAN\000UWB\000UNKNOWN\000"
-  "VIDEO_NEXT\000VIDEO_PREV\000BRIGHTNESS_CYCLE\000BRIGHTNESS_AUTO\000DISPLAY_OFF\000"
-  "WWAN\000RFKILL\000MICMUTE\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000OK\000SELECT\000GOTO\000CLEAR\000POWER2\000OPTION\000INFO\000"
-  "TIME\000VENDOR\000ARCHIVE\000PROGRAM\000CHANNEL\000FAVORITES\000EPG\000"
-  "PVR\000MHP\000LANGUAGE\000TITLE\000SUBTITLE\000ANGLE\000FULL_SCREEN\000"
-  "MODE\000KEYBOARD\000ASPECT_RATIO\000PC\000TV\000TV2\000VCR\000VCR2\000"
-  "SAT\000SAT2\000CD\000TAPE\000RADIO\000TUNER\000PLAYER\000TEXT\000DVD\000"
-  "AUX\000MP3\000AUDIO\000VIDEO\000DIRECTORY\000LIST\000MEMO\000CALENDAR\000"
-  "RED\000GREEN\000YELLOW\000BLUE\000CHANNELUP\000CHANNELDOWN\000FIRST\000"
-  "LAST\000AB\000NEXT\000RESTART\000SLOW\000SHUFFLE\000BREAK\000PREVIOUS\000"
-  "DIGITS\000TEEN\000TWEN\000VIDEOPHONE\000GAMES\000ZOOMIN\000ZOOMOUT\000"
-  "ZOOMRESET\000WORDPROCESSOR\000EDITOR\000SPREADSHEET\000GRAPHICSEDITOR\000"
-  "PRESENTATION\000DATABASE\000NEWS\000VOICEMAIL\000ADDRESSBOOK\000MESSENGER\000"
-  "DISPLAYTOGGLE\000SPELLCHECK\000LOGOFF\000DOLLAR\000EURO\000FRAMEBACK\000"
-  "FRAMEFORWARD\000CONTEXT_MENU\000MEDIA_REPEAT\00010CHANNELSUP\00010CHANNELSDOWN\000"
-  "IMAGES\000\000NOTIFICATION_CENTER\000PICKUP_PHONE\000HANGUP_PHONE\000\000"
-  "DEL_EOL\000DEL_EOS\000INS_LINE\000DEL_LINE\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000FN\000FN_ESC\000FN_F1\000FN_F2\000FN_F3\000FN_F4\000"
-  "FN_F5\000FN_F6\000FN_F7\000FN_F8\000FN_F9\000FN_F10\000FN_F11\000FN_F12\000"
-  "FN_1\000FN_2\000FN_D\000FN_E\000FN_F\000FN_S\000FN_B\000FN_RIGHT_SHIFT\000"
-  "\000\000\000\000\000\000\000\000\000\000\000BRL_DOT1\000BRL_DOT2\000"
-  "BRL_DOT3\000BRL_DOT4\000BRL_DOT5\000BRL_DOT6\000BRL_DOT7\000BRL_DOT8\000"
-  "BRL_DOT9\000BRL_DOT10\000\000\000\000\000\000NUMERIC_0\000NUMERIC_1\000"
-  "NUMERIC_2\000NUMERIC_3\000NUMERIC_4\000NUMERIC_5\000NUMERIC_6\000NUMERIC_7\000"
-  "NUMERIC_8\000NUMERIC_9\000NUMERIC_STAR\000NUMERIC_POUND\000NUMERIC_A\000"
-  "NUMERIC_B\000NUMERIC_C\000NUMERIC_D\000CAMERA_FOCUS\000WPS_BUTTON\000"
-  "TOUCHPAD_TOGGLE\000TOUCHPAD_ON\000TOUCHPAD_OFF\000CAMERA_ZOOMIN\000CAMERA_ZOOMOUT\000"
-  "CAMERA_UP\000CAMERA_DOWN\000CAMERA_LEFT\000CAMERA_RIGHT\000ATTENDANT_ON\000"
-  "ATTENDANT_OFF\000ATTENDANT_TOGGLE\000LIGHTS_TOGGLE\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000ALS_TOGGLE\000"
-  "ROTATE_LOCK_TOGGLE\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
-  "BUTTONCONFIG\000TASKMANAGER\000JOURNAL\000CONTROLPANEL\000APPSELECT\000"
-  "SCREENSAVER\000VOICECOMMAND\000ASSISTANT\000KBD_LAYOUT_NEXT\000EMOJI_PICKER\000\000"
-  "\000\000\000\000\000BRIGHTNESS_MIN\000BRIGHTNESS_MAX\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000KBDINPUTASSIST_PREV\000"
-  "KBDINPUTASSIST_NEXT\000KBDINPUTASSIST_PREVGROUP\000KBDINPUTASSIST_NEXTGROUP\000"
-  "KBDINPUTASSIST_ACCEPT\000KBDINPUTASSIST_CANCEL\000RIGHT_UP\000RIGHT_DOWN\000LEFT_UP\000"
-  "LEFT_DOWN\000ROOT_MENU\000MEDIA_TOP_MENU\000NUMERIC_11\000NUMERIC_12\000"
-  "AUDIO_DESC\0003D_MODE\000NEXT_FAVORITE\000STOP_RECORD\000PAUSE_RECORD\000VOD\000"
-  "UNMUTE\000FASTREVERSE\000SLOWREVERSE\000DATA\000ONSCREEN_KEYBOARD\000"
-  "PRIVACY_SCREEN_TOGGLE\000SELECTIVE_SCREENSHOT\000\000\000\000\000\000\000\000\000\000\000\000"
-  "\000\000\000\000\000\000\000\000\000\000MACRO1\000MACRO2\000MACRO3\000"
-  "MACRO4\000MACRO5\000MACRO6\000MACRO7\000MACRO8\000MACRO9\000MACRO10\000"
-  "MACRO11\000MACRO12\000MACRO13\000MACRO14\000MACRO15\000MACRO16\000MACRO17\000"
-  "MACRO18\000MACRO19\000MACRO20\000MACRO21\000MACRO22\000MACRO23\000MACRO24\000"
-  "MACRO25\000MACRO26\000MACRO27\000MACRO28\000MACRO29\000MACRO30\000\000\000"
-  "MACRO_RECORD_START\000MACRO_RECORD_STOP\000MACRO_PRESET_CYCLE\000MACRO_PRESET1\000"
-  "MACRO_PRESET2\000MACRO_PRESET3\000\000\000KBD_LCD_MENU1\000KBD_LCD_MENU2\000"
-  "KBD_LCD_MENU3\000KBD_LCD_MENU4\000KBD_LCD_MENU5\000";
 #endif
@@ -1,42 +1,116 @@
+// SPDX-License-Identifier: MIT
+
+/* key state machine, see libbuttond.h */
+
 #include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
-#include "buttond.h"
+#include "libbuttond_private.h"
 #include "keynames.h"
+#include "time_utils.h"
 
-static const char *keynames[KEY_MAX];
+/* must match hash() in gen_keynames_h.sh, case insensitive */
+static uint32_t name_hash(const char *name, uint32_t seed) {
+	uint64_t hash = seed, mult = 31 + 2 * seed;
 
-void init_keynames(void) {
-	size_t idx = 0;
-	/* starts at 1... */
-	for (int i = 1;
-	     i < KEY_MAX && idx < sizeof(allkeynames);
-	     i++, idx += strlen(&allkeynames[idx]) + 1) {
-		keynames[i] = &allkeynames[idx];
-	}
+	for (; *name; name++)
+		hash = (hash * mult + toupper((unsigned char)*name)) % 2147483647;
+	return hash;
 }
 
-uint16_t find_key_by_name(char *arg) {
-	/* XXX if this is too slow try to optimize later, but list is not so big */
-	for (int i = 0; arg[i]; i++) {
-		/* We require ASCII name anyway: make it uppercase to match header.
-		 * This doesn't bother pure digits for fallback. */
-		arg[i] = toupper(arg[i]);
-	}
-	for (size_t i = 0; i < KEY_MAX; i++) {
-		if (!keynames[i])
-			continue;
-		if (strcmp(keynames[i], arg) == 0) {
-			return i;
-		}
+static const struct code_names *names_by_type(uint16_t type) {
+	switch (type) {
+	case EV_KEY:
+		return &key_names;
+	case EV_SW:
+		return &sw_names;
+	case EV_ABS:
+		return &abs_names;
 	}
-	return 0;
+	return NULL;
 }
 
-const char *keyname_by_code(uint16_t code) {
-	if (code > KEY_MAX || !keynames[code])
-		return "unknown";
-	return keynames[code];
+int buttond_event_code_by_name(uint16_t type, const char *name) {
+	const struct code_names *names = names_by_type(type);
+	const struct code_name *slot;
+	uint32_t seed;
+
+	if (!names)
+		return -1;
+	seed = names->seeds[name_hash(name, 0) % names->seed_count];
+	slot = &names->slots[name_hash(name, seed) % names->slot_count];
+	if (slot->name == NAME_NONE
+	    || strcasecmp(&names->strings[slot->name], name))
+		return -1;
+	return slot->code;
+}
+
+const char *buttond_event_code_name(uint16_t type, uint16_t code) {
+	const struct code_names *names = names_by_type(type);
+
+	if (!names || code >= names->code_count
+	    || names->by_code[code] == NAME_NONE)
+		return NULL;
+	return &names->strings[names->by_code[code]];
+}
+
+uint16_t buttond_find_key_by_name(const char *name) {
+	int code = buttond_event_code_by_name(EV_KEY, name);
+
+	return code < 0 ? 0 : code;
+}
+
+const char *buttond_keyname_by_code(uint16_t code) {
+	const char *name = buttond_event_code_name(EV_KEY, code);
+
+	return name ? name : "unknown";
+}
+
+__attribute__((format(printf, 3, 4)))
+static void bd_log(struct buttond *bd, int level, const char *fmt, ...) {
+	va_list ap;
+
+	if (!bd->ops->log)
+		return;
+	va_start(ap, fmt);
+	bd->ops->log(bd, level, fmt, ap);
+	va_end(ap);
+}
+
+/* statistics */
+
+static void hist_add(uint32_t *buckets, uint64_t value) {
+	int bucket = value ? 64 - __builtin_clzll(value) : 0;
+
+	if (bucket >= BUTTOND_STATS_BUCKETS)
+		bucket = BUTTOND_STATS_BUCKETS - 1;
+	buckets[bucket]++;
+}
+
+void buttond_stats_latency(struct buttond_key *key, enum buttond_latency latency,
+			   int64_t nsecs) {
+	struct buttond_latency_hist *hist = &key->stats->latency[latency];
+	uint64_t usecs = nsecs > 0 ? nsecs / NSECS_IN_USEC : 0;
+
+	hist_add(hist->buckets, usecs);
+	if (usecs > hist->max_usecs)
+		hist->max_usecs = usecs;
+}
+
+static void stats_press_duration(struct buttond_key *key, int64_t msecs) {
+	hist_add(key->stats->press_duration, msecs > 0 ? msecs : 0);
+}
+
+void key_set_state(struct buttond *bd, struct buttond_key *key,
+		   enum buttond_key_state new_state) {
+	key->stats->state_nsecs[key->state] +=
+		time_diff_ns(&bd->now, &key->ts_state);
+	key->ts_state = bd->now;
+	key->state = new_state;
 }
 
 static void tv_from_event(struct timeval *tv, struct input_event *event) {
@@ -47,109 +121,178 @@ static void tv_from_event(struct timeval *tv, struct input_event *event) {
 	tv->tv_usec = event->input_event_usec;
 }
 
-void arm_key_press(struct key *key, bool reset_pressed) {
-	key->state = KEY_PRESSED;
+/* taps held at least that long are long taps */
+static int tap_long_msecs(struct buttond_key *key) {
+	/* shortest short action is first */
+	if (key->action_count && key->actions[0].type == BUTTOND_SHORT_PRESS)
+		return key->actions[0].trigger_time;
+	return BUTTOND_DEFAULT_SHORT_PRESS_MSECS;
+}
+
+void arm_key_press(struct buttond *bd, struct buttond_key *key, bool reset_pressed) {
+	int trigger_time = -1;
+
+	key_set_state(bd, key, BUTTOND_KEY_PRESSED);
 
 	/* short action is always first, so if last action is not LONG there
-	 * are none. We only set a timeout if we have one.*/
-	struct action *action = &key->actions[key->action_count-1];
-	if (action->type != LONG_PRESS) {
-		key->has_wakeup = false;
+	 * are none. We only set a timeout if we have one.
+	 * Keys only used in chords have no action at all.
+	 * Long actions are only for a first press: in a sequence we only
+	 * wait to tell a long tap, if a sequence goes on with one */
+	if (key->tap_pos) {
+		if (key->taps[key->tap_pos].next[1])
+			trigger_time = tap_long_msecs(key);
+	} else if (key->action_count
+		   && key->actions[key->action_count-1].type == BUTTOND_LONG_PRESS) {
+		trigger_time = key->actions[key->action_count-1].trigger_time;
+	}
+	if (trigger_time < 0) {
+		timer_cancel(bd, &key->wakeup);
 		return;
 	}
-	key->has_wakeup = true;
+	struct timespec ts;
 	if (reset_pressed) {
-		time_gettime(&key->ts_wakeup);
-		time_ts2tv(&key->tv_pressed, &key->ts_wakeup, 0);
-                time_add_ts(&key->ts_wakeup, action->trigger_time);
+		/* no event to measure latency from */
+		key->read_latency = -1;
+		ts = bd->now;
+		time_ts2tv(&key->tv_pressed, &ts, 0);
+		time_add_ts(&ts, trigger_time);
 	} else {
-		time_tv2ts(&key->ts_wakeup, &key->tv_pressed,
-			   action->trigger_time);
+		time_tv2ts(&ts, &key->tv_pressed, trigger_time);
+	}
+	timer_arm(bd, &key->wakeup, &ts);
+}
+
+/* chords */
+
+/* key was taken over by a chord: forget its press */
+static void chord_suppress(struct buttond *bd, struct buttond_key *key) {
+	if (key->state != BUTTOND_KEY_PRESSED)
+		return;
+	key->tap_pos = 0;
+	timer_cancel(bd, &key->wakeup);
+	key_set_state(bd, key, BUTTOND_KEY_HANDLED);
+}
+
+/* key went up or down: press or release chords it is in.
+ * event is NULL if it was found in that state without event (e.g.
+ * on open) */
+static void chord_update(struct buttond *bd, struct buttond_key *key, bool down,
+			 struct input_event *event) {
+	/* key repeat */
+	if (down == !!(bd->keys_down & key->chord_bit))
+		return;
+	bd->keys_down ^= key->chord_bit;
+
+	for (uint64_t chords = key->chords; chords; chords &= chords - 1) {
+		struct buttond_key *chord = buttond_key_by_code(bd,
+				KEY_CNT + __builtin_ctzll(chords));
+
+		if (!down) {
+			if (chord->state != BUTTOND_KEY_PRESSED
+			    && chord->state != BUTTOND_KEY_HANDLED)
+				continue;
+			if (event)
+				buttond_handle_key(bd, event, chord, &bd->now);
+			else
+				buttond_key_released(bd, chord, &bd->now);
+			continue;
+		}
+		if ((bd->keys_down & chord->chord_mask) != chord->chord_mask)
+			continue;
+		if (event)
+			buttond_handle_key(bd, event, chord, &bd->now);
+		else
+			buttond_key_pressed(bd, chord, &bd->now);
+		for (uint64_t bits = chord->chord_mask; bits; bits &= bits - 1)
+			chord_suppress(bd, buttond_key_by_code(bd,
+				bd->chord_keys[__builtin_ctzll(bits)]));
+		for (uint64_t subsets = chord->chords; subsets;
+		     subsets &= subsets - 1)
+			chord_suppress(bd, buttond_key_by_code(bd,
+				KEY_CNT + __builtin_ctzll(subsets)));
 	}
 }
 
-void handle_key(struct state *state, struct input_event *event,
-		struct key *key) {
+void buttond_handle_key(struct buttond *bd, struct input_event *event,
+			struct buttond_key *key, const struct timespec *now) {
+	struct timespec ts;
+	struct timeval tv;
+
+	bd->now = *now;
+	tv_from_event(&tv, event);
+	time_tv2ts(&ts, &tv, 0);
+	key->read_latency = time_diff_ns(&bd->now, &ts);
+
 	switch (key->state) {
-	case KEY_RELEASED:
-	case KEY_DEBOUNCE:
+	case BUTTOND_KEY_RELEASED:
+	case BUTTOND_KEY_DEBOUNCE:
+	case BUTTOND_KEY_TAPPED:
 		/* new key press -- can be a release if program started with key or handled long press */
 		if (event->value == 0)
 			break;
 
 		/* don't reset timestamp/wakeup on debounce */
-		if (key->state == KEY_RELEASED) {
+		if (key->state != BUTTOND_KEY_DEBOUNCE) {
 			tv_from_event(&key->tv_pressed, event);
+			key->stats->presses++;
+		} else {
+			key->stats->debounce_merges++;
 		}
-		arm_key_press(key, false);
+		arm_key_press(bd, key, false);
 		break;
-	case KEY_PRESSED:
+	case BUTTOND_KEY_PRESSED:
 		/* ignore repress */
 		if (event->value != 0)
 			break;
 		/* mark key for debounce, we will handle event after timeout */
-		key->state = KEY_DEBOUNCE;
+		key_set_state(bd, key, BUTTOND_KEY_DEBOUNCE);
 		tv_from_event(&key->tv_released, event);
-		key->has_wakeup = true;
-		time_gettime(&key->ts_wakeup);
-		time_add_ts(&key->ts_wakeup, state->debounce_msecs);
+		time_tv2ts(&ts, &key->tv_released, bd->debounce_msecs);
+		timer_arm(bd, &key->wakeup, &ts);
 		break;
-	case KEY_HANDLED:
+	case BUTTOND_KEY_HANDLED:
 		/* ignore until key down */
 		if (event->value != 0)
 			break;
-		key->state = KEY_RELEASED;
-	}
-}
-
-int compute_timeout(struct key *keys, int key_count) {
-	int i;
-	int timeout = -1;
-	struct timespec ts;
-	time_gettime(&ts);
-
-	for (i = 0; i < key_count; i++) {
-		if (keys[i].has_wakeup) {
-			int64_t diff = time_diff_ts(&keys[i].ts_wakeup, &ts);
-			if (diff < 0)
-				timeout = 0;
-			else if (timeout == -1 || diff < timeout)
-				timeout = diff;
-		}
-	}
-	if (debug > 3) {
-		if (timeout >= 0) {
-			printf("wakeup scheduled in %d\n", timeout);
-		} else {
-			printf("no wakeup scheduled\n");
+		stats_press_duration(key, time_diff_tv(&tv, &key->tv_pressed));
+		if (!key->tap_pos) {
+			key_set_state(bd, key, BUTTOND_KEY_RELEASED);
+			break;
 		}
+		/* long tap in a sequence, wait for the next one */
+		key_set_state(bd, key, BUTTOND_KEY_TAPPED);
+		key->tv_released = tv;
+		time_tv2ts(&ts, &tv, key->taps[key->tap_pos].gap_msecs);
+		timer_arm(bd, &key->wakeup, &ts);
 	}
-
-	return timeout;
+	if (key->chord_bit)
+		chord_update(bd, key, event->value != 0, event);
 }
 
-static bool action_match(struct action *action, int time) {
+static bool action_match(struct buttond_action *action, int time) {
 	switch (action->type) {
-	case LONG_PRESS:
+	case BUTTOND_LONG_PRESS:
 		return time >= action->trigger_time;
-	case SHORT_PRESS:
+	case BUTTOND_SHORT_PRESS:
 		return time < action->trigger_time;
-	default:
-		xassert(false, "invalid action!!");
+	case BUTTOND_SEQUENCE:
+		break;
 	}
+	return false;
 }
 
-static struct action *find_key_action(struct key *key, int time) {
+static struct buttond_action *find_key_action(struct buttond_key *key, int time) {
 	/* check short keys in growing order, then long keys in
 	 * decreasing order to get the best match */
 	for (int i = 0; i < key->action_count; i++) {
-		if (key->actions[i].type != SHORT_PRESS)
+		if (key->actions[i].type != BUTTOND_SHORT_PRESS)
 			break;
 		if (action_match(&key->actions[i], time))
 			return &key->actions[i];
 	}
 	for (int i = key->action_count - 1; i >= 0; i--) {
-		if (key->actions[i].type != LONG_PRESS)
+		if (key->actions[i].type != BUTTOND_LONG_PRESS)
 			break;
 		if (action_match(&key->actions[i], time))
 			return &key->actions[i];
@@ -157,59 +300,633 @@ static struct action *find_key_action(struct key *key, int time) {
 	return NULL;
 }
 
-void handle_timeouts(struct key *keys, int key_count) {
-	int i;
+static void run_action(struct buttond *bd, struct buttond_key *key,
+		       struct buttond_action *action, int64_t diff,
+		       struct buttond_timer *timer) {
+	if (key->read_latency >= 0)
+		buttond_stats_latency(key, BUTTOND_LATENCY_READ, key->read_latency);
+	buttond_stats_latency(key, BUTTOND_LATENCY_DECISION,
+			      time_diff_ns(&bd->now, &timer->ts));
+	switch (action->type) {
+	case BUTTOND_SHORT_PRESS:
+		key->stats->short_actions++;
+		break;
+	case BUTTOND_LONG_PRESS:
+		key->stats->long_actions++;
+		break;
+	case BUTTOND_SEQUENCE:
+		key->stats->sequence_actions++;
+		break;
+	}
+	bd->ops->action(bd, key, action, diff);
+}
+
+/* press decided (on release, or while held for a long tap): follow
+ * sequences with it, returns false if this is a first press that
+ * starts none. One step in the trie whatever the number of sequences */
+static bool key_tap(struct buttond *bd, struct buttond_key *key, int64_t diff,
+		    struct buttond_timer *timer) {
+	int next = key->taps[key->tap_pos].next[diff >= tap_long_msecs(key)];
+	struct buttond_tap_node *node = &key->taps[next];
 	struct timespec ts;
-	time_gettime(&ts);
-
-	for (i = 0; i < key_count; i++) {
-		if (keys[i].has_wakeup
-		    && (time_diff_ts(&keys[i].ts_wakeup, &ts) <= 0)) {
-			if (debug > 3)
-				printf("we are %ld ahead of timeout\n",
-				       time_diff_ts(&keys[i].ts_wakeup, &ts));
-
-			if (keys[i].state != KEY_DEBOUNCE) {
-				/* key still pressed - set artifical release time */
-				time_ts2tv(&keys[i].tv_released, &ts, 0);
+
+	if (!next && !key->tap_pos)
+		return false;
+	key->tap_pos = next;
+	if (!next) {
+		key->stats->ignored_releases++;
+		bd_log(bd, 1, "ignoring key %s (%d) taps matching no sequence",
+		       buttond_key_name(key), key->code);
+	} else if (!node->next[0] && !node->next[1]) {
+		/* no longer sequence to wait for */
+		run_action(bd, key, &key->actions[node->action], diff, timer);
+		key->tap_pos = 0;
+	} else if (key->state == BUTTOND_KEY_DEBOUNCE) {
+		stats_press_duration(key, diff);
+		key_set_state(bd, key, BUTTOND_KEY_TAPPED);
+		time_tv2ts(&ts, &key->tv_released, node->gap_msecs);
+		timer_arm(bd, &key->wakeup, &ts);
+		return true;
+	}
+	/* a long tap still held goes on (or ends) on release */
+	if (key->state == BUTTOND_KEY_DEBOUNCE) {
+		stats_press_duration(key, diff);
+		key_set_state(bd, key, BUTTOND_KEY_RELEASED);
+	} else {
+		key_set_state(bd, key, BUTTOND_KEY_HANDLED);
+	}
+	return true;
+}
+
+/* no tap followed in time: run the sequence that ends there if any,
+ * or actions of a single press */
+static void key_taps_end(struct buttond *bd, struct buttond_key *key,
+			 struct buttond_timer *timer) {
+	struct buttond_tap_node *node = &key->taps[key->tap_pos];
+	int64_t diff = time_diff_tv(&key->tv_released, &key->tv_pressed);
+	struct buttond_action *action = NULL;
+
+	if (node->action >= 0)
+		action = &key->actions[node->action];
+	else if (key->tap_pos == key->taps[0].next[0]
+		 || key->tap_pos == key->taps[0].next[1])
+		action = find_key_action(key, diff);
+	if (action) {
+		run_action(bd, key, action, diff, timer);
+	} else {
+		key->stats->ignored_releases++;
+		bd_log(bd, 1, "ignoring key %s (%d) taps matching no sequence",
+		       buttond_key_name(key), key->code);
+	}
+	key->tap_pos = 0;
+	key_set_state(bd, key, BUTTOND_KEY_RELEASED);
+}
+
+void buttond_handle_timeouts(struct buttond *bd, const struct timespec *now) {
+	struct buttond_timer *timer;
+
+	bd->now = *now;
+	while ((timer = timer_pop_expired(bd))) {
+		struct buttond_key *key = container_of(timer, struct buttond_key, wakeup);
+
+		bd_log(bd, 4, "we are %ld ahead of timeout",
+		       time_diff_ts(&timer->ts, &bd->now));
+
+		if (key->state == BUTTOND_KEY_TAPPED) {
+			key_taps_end(bd, key, timer);
+			continue;
+		}
+		if (key->state != BUTTOND_KEY_DEBOUNCE) {
+			/* key still pressed - set artifical release time */
+			time_ts2tv(&key->tv_released, &bd->now, 0);
+		}
+
+		int64_t diff = time_diff_tv(&key->tv_released,
+					    &key->tv_pressed);
+		/* a first press still held is a long press */
+		if (key->tap_node_count
+		    && (key->tap_pos || key->state == BUTTOND_KEY_DEBOUNCE)
+		    && key_tap(bd, key, diff, timer))
+			continue;
+		struct buttond_action *action = find_key_action(key, diff);
+		if (action) {
+			run_action(bd, key, action, diff, timer);
+		} else if (key->state != BUTTOND_KEY_DEBOUNCE) {
+			bd_log(bd, 0, "Woke up for key %s (%d) after %"PRId64" ms without any associated action, this should not happen!",
+			       buttond_key_name(key), key->code, diff);
+		} else if (key->action_count) {
+			key->stats->ignored_releases++;
+			bd_log(bd, 1, "ignoring key %s (%d) released after %"PRId64" ms",
+			       buttond_key_name(key), key->code, diff);
+		}
+
+		if (key->state == BUTTOND_KEY_DEBOUNCE) {
+			stats_press_duration(key, diff);
+			key_set_state(bd, key, BUTTOND_KEY_RELEASED);
+		} else {
+			key_set_state(bd, key, BUTTOND_KEY_HANDLED);
+		}
+	}
+}
+
+bool buttond_handle_event(struct buttond *bd, struct input_event *event,
+			  const struct timespec *now) {
+	if (event->type != EV_KEY || event->code >= KEY_CNT
+	    || !is_bit_set(bd->key_bitmap, event->code))
+		return false;
+	buttond_handle_key(bd, event, buttond_key_by_code(bd, event->code), now);
+	return true;
+}
+
+void buttond_key_pressed(struct buttond *bd, struct buttond_key *key,
+			 const struct timespec *now) {
+	bd->now = *now;
+	if (key->state == BUTTOND_KEY_DEBOUNCE) {
+		/* pressed again before the release was decided */
+		key->stats->debounce_merges++;
+		arm_key_press(bd, key, false);
+	} else {
+		/* taps cannot be timed without events */
+		key->tap_pos = 0;
+		arm_key_press(bd, key, true);
+	}
+	if (key->chord_bit)
+		chord_update(bd, key, true, NULL);
+}
+
+void buttond_key_released(struct buttond *bd, struct buttond_key *key,
+			  const struct timespec *now) {
+	bd->now = *now;
+	if (key->chord_bit)
+		chord_update(bd, key, false, NULL);
+	if (key->state != BUTTOND_KEY_PRESSED && key->state != BUTTOND_KEY_HANDLED)
+		return;
+	if (key->state == BUTTOND_KEY_PRESSED)
+		key->stats->ignored_releases++;
+	key->tap_pos = 0;
+	timer_cancel(bd, &key->wakeup);
+	key_set_state(bd, key, BUTTOND_KEY_RELEASED);
+}
+
+/* setup */
+
+int buttond_reserve(struct buttond *bd, int key_count) {
+	if (key_count <= bd->key_alloc)
+		return 0;
+	if (bd->static_keys)
+		return -1;
+
+	struct buttond_key *keys = realloc(bd->keys, key_count * sizeof(*keys));
+	if (!keys)
+		return -1;
+	bd->keys = keys;
+	bd->key_alloc = key_count;
+	return 0;
+}
+
+/* key or chord for code, added without action if missing */
+static struct buttond_key *key_get(struct buttond *bd, uint16_t code) {
+	struct buttond_key *key = buttond_key_by_code(bd, code);
+
+	if (!key) {
+		if (bd->key_count == bd->key_alloc) {
+			int alloc = bd->key_alloc ? bd->key_alloc * 2 : 4;
+			struct buttond_key *keys = realloc(bd->keys,
+							   alloc * sizeof(*keys));
+			if (!keys)
+				return NULL;
+			bd->keys = keys;
+			bd->key_alloc = alloc;
+		}
+		key = &bd->keys[bd->key_count];
+		bd->key_count++;
+		bd->key_index[code] = bd->key_count;
+		memset(key, 0, sizeof(*key));
+		key->code = code;
+		key->state = BUTTOND_KEY_RELEASED;
+		key->wakeup.heap_pos = -1;
+		key->read_latency = -1;
+	}
+	return key;
+}
+
+static struct buttond_action *key_add_action(struct buttond_key *key) {
+	/* grow actions by powers of two */
+	if ((key->action_count & (key->action_count - 1)) == 0) {
+		struct buttond_action *actions = realloc(key->actions,
+				(key->action_count ? key->action_count * 2 : 1)
+				* sizeof(*actions));
+		if (!actions)
+			return NULL;
+		key->actions = actions;
+	}
+
+	/* insert at the end, we'll sort on start */
+	struct buttond_action *action = &key->actions[key->action_count];
+	key->action_count++;
+	memset(action, 0, sizeof(*action));
+	action->type = BUTTOND_SHORT_PRESS;
+	action->trigger_time = BUTTOND_DEFAULT_SHORT_PRESS_MSECS;
+	return action;
+}
+
+struct buttond_action *buttond_add_action(struct buttond *bd, uint16_t code) {
+	if (code >= KEY_CNT || bd->static_keys)
+		return NULL;
+
+	struct buttond_key *key = key_get(bd, code);
+	if (!key)
+		return NULL;
+	return key_add_action(key);
+}
+
+static int compare_codes(const void *v1, const void *v2) {
+	return *(const uint16_t *)v1 - *(const uint16_t *)v2;
+}
+
+/* member names joined by +, codes are sorted so the same keys always
+ * give the same name */
+static char *chord_name(const uint16_t *codes, int count) {
+	char name[BUTTOND_MAX_CHORD_KEYS * 32];
+	size_t len = 0;
+
+	for (int i = 0; i < count; i++) {
+		const char *key = buttond_event_code_name(EV_KEY, codes[i]);
+
+		if (key)
+			len += snprintf(name + len, sizeof(name) - len, "%s%s",
+					i ? "+" : "", key);
+		else
+			len += snprintf(name + len, sizeof(name) - len, "%s%d",
+					i ? "+" : "", codes[i]);
+	}
+	return strdup(name);
+}
+
+struct buttond_action *buttond_add_chord(struct buttond *bd, const uint16_t *codes,
+					 int count) {
+	uint16_t sorted[BUTTOND_MAX_CHORD_KEYS];
+	uint64_t mask = 0;
+	int n = 0, new_keys = 0;
+	struct buttond_key *chord = NULL;
+
+	if (bd->static_keys || count > BUTTOND_MAX_CHORD_KEYS) {
+		errno = bd->static_keys ? EINVAL : ENOSPC;
+		return NULL;
+	}
+	for (int i = 0; i < count; i++) {
+		if (!codes[i] || codes[i] >= KEY_CNT) {
+			errno = EINVAL;
+			return NULL;
+		}
+		sorted[i] = codes[i];
+	}
+	qsort(sorted, count, sizeof(sorted[0]), compare_codes);
+	for (int i = 0; i < count; i++)
+		if (!n || sorted[n - 1] != sorted[i])
+			sorted[n++] = sorted[i];
+	if (n < 2) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (int i = 0; i < n; i++) {
+		struct buttond_key *key = buttond_key_by_code(bd, sorted[i]);
+
+		if (key && key->chord_bit)
+			mask |= key->chord_bit;
+		else
+			new_keys++;
+	}
+	/* same keys as an existing chord */
+	for (int i = 0; !new_keys && i < bd->chord_count; i++) {
+		chord = buttond_key_by_code(bd, KEY_CNT + i);
+		if (chord->chord_mask == mask)
+			return key_add_action(chord);
+	}
+	if (bd->chord_count == BUTTOND_MAX_CHORDS
+	    || bd->chord_key_count + new_keys > BUTTOND_MAX_CHORD_KEYS) {
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	for (int i = 0; i < n; i++) {
+		struct buttond_key *key = key_get(bd, sorted[i]);
+
+		if (!key)
+			return NULL;
+		if (!key->chord_bit) {
+			key->chord_bit = 1ULL << bd->chord_key_count;
+			bd->chord_keys[bd->chord_key_count++] = sorted[i];
+		}
+		mask |= key->chord_bit;
+	}
+	chord = key_get(bd, KEY_CNT + bd->chord_count);
+	if (!chord)
+		return NULL;
+	chord->name = chord_name(sorted, n);
+	if (!chord->name)
+		return NULL;
+	chord->chord_mask = mask;
+	for (int i = 0; i < n; i++)
+		buttond_key_by_code(bd, sorted[i])->chords |= 1ULL << bd->chord_count;
+	bd->chord_count++;
+	return key_add_action(chord);
+}
+
+struct buttond_action *buttond_add_key_action(struct buttond *bd,
+					      struct buttond *from, struct buttond_key *key) {
+	uint16_t codes[BUTTOND_MAX_CHORD_KEYS];
+	int n = 0;
+
+	if (key->code < KEY_CNT)
+		return buttond_add_action(bd, key->code);
+	for (uint64_t bits = key->chord_mask; bits; bits &= bits - 1)
+		codes[n++] = from->chord_keys[__builtin_ctzll(bits)];
+	return buttond_add_chord(bd, codes, n);
+}
+
+struct buttond_key *buttond_same_key(struct buttond *bd, struct buttond_key *key) {
+	if (key->code < KEY_CNT)
+		return buttond_key_by_code(bd, key->code);
+	for (int i = 0; i < bd->chord_count; i++) {
+		struct buttond_key *chord = buttond_key_by_code(bd, KEY_CNT + i);
+
+		if (!strcmp(chord->name, key->name))
+			return chord;
+	}
+	return NULL;
+}
+
+/* short actions first, then sequences, then long actions */
+static int action_order(const struct buttond_action *action) {
+	switch (action->type) {
+	case BUTTOND_SHORT_PRESS:
+		return 0;
+	case BUTTOND_SEQUENCE:
+		return 1;
+	case BUTTOND_LONG_PRESS:
+		break;
+	}
+	return 2;
+}
+
+static int sort_actions_compare(const void *v1, const void *v2) {
+	const struct buttond_action *a1 = (const struct buttond_action*)v1;
+	const struct buttond_action *a2 = (const struct buttond_action*)v2;
+	if (action_order(a1) != action_order(a2))
+		return action_order(a1) - action_order(a2);
+	if (a1->type == BUTTOND_SEQUENCE)
+		return a1->taps - a2->taps;
+	if (a1->trigger_time < a2->trigger_time)
+		return -1;
+	if (a1->trigger_time > a2->trigger_time)
+		return 1;
+	return 0;
+}
+
+/* taps as s and l, for messages */
+static const char *taps_name(uint16_t taps, char *buf) {
+	int n = 0;
+
+	for (int bit = 30 - __builtin_clz(taps); bit >= 0; bit--)
+		buf[n++] = taps & (1 << bit) ? 'l' : 's';
+	buf[n] = 0;
+	return buf;
+}
+
+/* build the trie of sequences, their actions are sorted */
+static int build_taps(struct buttond *bd, struct buttond_key *key) {
+	char name[BUTTOND_MAX_TAPS + 1];
+	int count = 1;
+
+	free(key->taps);
+	key->taps = NULL;
+	key->tap_node_count = 0;
+	key->tap_pos = 0;
+	for (int i = 0; i < key->action_count; i++) {
+		uint16_t taps = key->actions[i].taps;
+
+		if (key->actions[i].type != BUTTOND_SEQUENCE)
+			continue;
+		if (taps < 2 || taps >= 2 << BUTTOND_MAX_TAPS) {
+			bd_log(bd, 0, "Key %s had a sequence of no or more than %d taps",
+			       buttond_key_name(key), BUTTOND_MAX_TAPS);
+			return -1;
+		}
+		count += 31 - __builtin_clz(taps);
+	}
+	if (count == 1)
+		return 0;
+	key->taps = calloc(count, sizeof(*key->taps));
+	if (!key->taps) {
+		bd_log(bd, 0, "Allocation failure");
+		return -1;
+	}
+	key->taps[0].action = -1;
+	key->tap_node_count = 1;
+
+	for (int i = 0; i < key->action_count; i++) {
+		struct buttond_action *action = &key->actions[i];
+		int node = 0;
+
+		if (action->type != BUTTOND_SEQUENCE)
+			continue;
+		for (int bit = 30 - __builtin_clz(action->taps); bit >= 0;
+		     bit--) {
+			struct buttond_tap_node *cur = &key->taps[node];
+			int tap = !!(action->taps & (1 << bit));
+
+			if (cur->gap_msecs < action->trigger_time)
+				cur->gap_msecs = action->trigger_time;
+			if (!cur->next[tap]) {
+				cur->next[tap] = key->tap_node_count++;
+				key->taps[cur->next[tap]].action = -1;
 			}
+			node = cur->next[tap];
+		}
+		if (key->taps[node].action >= 0) {
+			bd_log(bd, 0, "Key %s had sequence %s defined twice",
+			       buttond_key_name(key), taps_name(action->taps, name));
+			return -1;
+		}
+		key->taps[node].action = i;
+	}
+	return 0;
+}
 
-			int64_t diff = time_diff_tv(&keys[i].tv_released,
-						    &keys[i].tv_pressed);
-			struct action *action = find_key_action(&keys[i], diff);
-			if (action) {
-				/* special keys can have no action */
-				if (action->action && action->action[0]) {
-					if (debug)
-						printf("running %s after %"PRId64" ms\n",
-						       action->action, diff);
-					system(action->action);
-				}
-				if (action->exit_after) {
-					if (debug && keys[i].code)
-						printf("Exiting after processing key %s (%d)\n",
-						       keyname_by_code(keys[i].code),
-						       keys[i].code);
-					else if (debug)
-						printf("Exiting after stop timeout\n");
-					exit(0);
-				}
-			} else if (keys[i].state != KEY_DEBOUNCE) {
-				fprintf(stderr,
-					"Woke up for key %s (%d) after %"PRId64" ms without any associated action, this should not happen!\n",
-					keyname_by_code(keys[i].code),
-					keys[i].code, diff);
-			} else if (debug) {
-				printf("ignoring key %s (%d) released after %"PRId64" ms\n",
-				       keyname_by_code(keys[i].code),
-				       keys[i].code, diff);
+int buttond_check(struct buttond *bd) {
+	memset(bd->key_bitmap, 0, sizeof(bd->key_bitmap));
+	for (int i = 0; i < bd->key_count; i++) {
+		struct buttond_key *key = &bd->keys[i];
+		qsort(key->actions, key->action_count,
+		      sizeof(key->actions[0]), sort_actions_compare);
+		struct buttond_action *a1 = NULL;
+		for (int j = 0; j < key->action_count; j++) {
+			struct buttond_action *a2 = &key->actions[j];
+
+			/* sequences are checked in their trie */
+			if (a2->type == BUTTOND_SEQUENCE)
+				continue;
+			if (!a1) {
+				a1 = a2;
+				continue;
+			}
+			if (a1->type != a2->type && a1->trigger_time > a2->trigger_time) {
+				bd_log(bd, 0, "Key %s had a short key (%d) longer than its shortest long key (%d)",
+				       buttond_key_name(key),
+				       a1->trigger_time, a2->trigger_time);
+				return -1;
 			}
+			if (a1->type == a2->type && a1->trigger_time == a2->trigger_time) {
+				bd_log(bd, 0, "Key %s was defined twice with %d ms %s action",
+				       buttond_key_name(key),
+				       a1->trigger_time,
+				       a1->type == BUTTOND_SHORT_PRESS ? "short" : "long");
+				return -1;
+			}
+			a1 = a2;
+		}
+		if (build_taps(bd, key) < 0)
+			return -1;
+		/* code 0 is our exit timeout, not a real key */
+		if (key->code && key->code < KEY_CNT)
+			set_bit(bd->key_bitmap, key->code);
+	}
+	for (int i = 0; i < bd->chord_count; i++) {
+		struct buttond_key *chord = buttond_key_by_code(bd, KEY_CNT + i);
 
-			keys[i].has_wakeup = false;
-			if (keys[i].state == KEY_DEBOUNCE)
-				keys[i].state = KEY_RELEASED;
-			else
-				keys[i].state = KEY_HANDLED;
+		chord->chords = 0;
+		for (int j = 0; j < bd->chord_count; j++) {
+			uint64_t mask = buttond_key_by_code(bd, KEY_CNT + j)->chord_mask;
+
+			if (j != i && (mask & chord->chord_mask) == mask)
+				chord->chords |= 1ULL << j;
+		}
+	}
+	return 0;
+}
+
+int buttond_start(struct buttond *bd, const struct timespec *now) {
+	struct buttond_key_stats *stats = NULL;
+	size_t key_count, missing_stats = 0;
+
+	/* static keys were checked when generated */
+	if (!bd->static_keys && buttond_check(bd) < 0)
+		return -1;
+	key_count = bd->key_count;
+	for (int i = 0; i < bd->key_count; i++) {
+		if (!bd->keys[i].stats)
+			missing_stats++;
+	}
+
+	/* one wakeup per key at most */
+	if (!bd->static_keys)
+		bd->timers = calloc(key_count, sizeof(*bd->timers));
+	if (missing_stats)
+		stats = calloc(missing_stats, sizeof(*stats));
+	if ((key_count && !bd->timers) || (missing_stats && !stats)) {
+		free(stats);
+		return -1;
+	}
+	bd->stats = stats;
+
+	bd->now = *now;
+	for (int i = 0; i < bd->key_count; i++) {
+		struct buttond_key *key = &bd->keys[i];
+
+		if (!key->stats) {
+			key->stats = stats++;
+			key->stats->code = key->code;
+			key->ts_state = bd->now;
+		}
+		/* start exit timeout */
+		if (key->code == 0)
+			arm_key_press(bd, key, true);
+	}
+	return 0;
+}
+
+int buttond_reload(struct buttond *bd, struct buttond *next,
+		   const struct timespec *now) {
+	struct buttond old;
+	size_t key_count;
+
+	key_count = next->key_count;
+	next->timers = calloc(key_count, sizeof(*next->timers));
+	if (key_count && !next->timers)
+		return -1;
+	next->ops = bd->ops;
+	next->now = *now;
+	next->timer_seq = bd->timer_seq;
+
+	for (int i = 0; i < next->key_count; i++) {
+		struct buttond_key *key = &next->keys[i];
+		struct buttond_key *prev = buttond_same_key(bd, key);
+
+		if (!prev) {
+			key->ts_state = next->now;
+			continue;
+		}
+		key->state = prev->state;
+		key->ts_state = prev->ts_state;
+		key->tv_pressed = prev->tv_pressed;
+		key->tv_released = prev->tv_released;
+		key->read_latency = prev->read_latency;
+		switch (key->state) {
+		case BUTTOND_KEY_PRESSED:
+			/* long press timer depends on new actions */
+			arm_key_press(next, key, false);
+			break;
+		case BUTTOND_KEY_DEBOUNCE:
+			/* release is still decided at the same time */
+			timer_arm(next, &key->wakeup, &prev->wakeup.ts);
+			break;
+		case BUTTOND_KEY_TAPPED:
+			/* new sequences start over */
+			key->state = BUTTOND_KEY_RELEASED;
+			break;
+		case BUTTOND_KEY_RELEASED:
+		case BUTTOND_KEY_HANDLED:
+			break;
+		}
+	}
+	/* keys that were not in chords before: assume down if held */
+	next->keys_down = 0;
+	for (int i = 0; i < next->chord_key_count; i++) {
+		struct buttond_key *prev = buttond_key_by_code(bd, next->chord_keys[i]);
+
+		if (prev && (prev->chord_bit
+			     ? bd->keys_down & prev->chord_bit
+			     : prev->state == BUTTOND_KEY_PRESSED
+			       || prev->state == BUTTOND_KEY_HANDLED))
+			next->keys_down |= 1ULL << i;
+	}
+
+	old = *bd;
+	*bd = *next;
+	*next = old;
+	return 0;
+}
+
+void buttond_free(struct buttond *bd) {
+	if (!bd->static_keys) {
+		for (int i = 0; i < bd->key_count; i++) {
+			free(bd->keys[i].actions);
+			free(bd->keys[i].taps);
+			free((char *)bd->keys[i].name);
 		}
+		free(bd->keys);
+		free(bd->timers);
 	}
+	free(bd->stats);
+	bd->stats = NULL;
+	bd->static_keys = false;
+	bd->keys = NULL;
+	bd->timers = NULL;
+	bd->key_count = bd->key_alloc = bd->timer_count = 0;
+	bd->chord_count = bd->chord_key_count = 0;
+	bd->keys_down = 0;
+	memset(bd->key_index, 0, sizeof(bd->key_index));
+	memset(bd->key_bitmap, 0, sizeof(bd->key_bitmap));
 }
@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LIBBUTTOND_H
+#define LIBBUTTOND_H
+
+/* Key handling state machine, usable without the daemon.
+ *
+ * The library does no I/O of its own: callers feed it input events and
+ * the current time (CLOCK_MONOTONIC, same clock as event timestamps),
+ * call buttond_handle_timeouts() when buttond_next_timeout() is due,
+ * and get matched actions back through buttond_ops callbacks.
+ * It never runs commands nor exits: what an action means is up to
+ * the caller.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+#include <linux/input.h>
+
+#include "stats.h"
+
+struct buttond_timer {
+	/* deadline */
+	struct timespec ts;
+	/* position in timers heap, -1 when not armed */
+	int heap_pos;
+	/* arming order, to break ties */
+	uint64_t seq;
+};
+
+#define BUTTOND_DEFAULT_SHORT_PRESS_MSECS 1000
+/* sequences: default max time between taps */
+#define BUTTOND_DEFAULT_TAP_GAP_MSECS 300
+#define BUTTOND_MAX_TAPS 8
+
+/* chords are keys with codes from KEY_CNT, see buttond_add_chord */
+#define BUTTOND_MAX_CHORDS 64
+/* distinct keys in all chords, one bit each in buttond.keys_down */
+#define BUTTOND_MAX_CHORD_KEYS 64
+
+struct buttond_action {
+	/* type of action (long/short press) */
+	enum buttond_action_type {
+		BUTTOND_LONG_PRESS,
+		BUTTOND_SHORT_PRESS,
+		/* sequence of taps, see taps */
+		BUTTOND_SEQUENCE,
+	} type;
+	/* cutoff time for action, for sequences max time between taps */
+	int trigger_time;
+	/* sequences: taps from the first, one bit each (1 for a long
+	 * tap) after a leading 1 bit, e.g. 0b1001 for short,short,long */
+	uint16_t taps;
+	/* command to run */
+	char const *action;
+	/* if set, run this directly instead of action through a shell */
+	char **argv;
+	/* whether to stop after action has been processed */
+	bool exit_after;
+	/* caller data, never touched by the library */
+	void *data;
+};
+
+struct buttond_key {
+	/* key code, 0 for exit timeout, KEY_CNT + index for chords */
+	uint16_t code;
+	/* chords: member key names joined by +, NULL for keys */
+	const char *name;
+
+	/* keys in chords: their bit in buttond.keys_down, 0 if none, and
+	 * chords they are in (by index).
+	 * chords: bits of their keys, and chords that are a subset of
+	 * this one (by index) */
+	uint64_t chord_bit;
+	uint64_t chords;
+	uint64_t chord_mask;
+
+	/* key actions */
+	int action_count;
+	struct buttond_action *actions;
+
+	/* sequences: trie of their taps built by buttond_check, node 0
+	 * is before the first tap, and node of taps so far */
+	struct buttond_tap_node *taps;
+	int tap_node_count;
+	uint16_t tap_pos;
+
+	/* counters, allocated by buttond_start if left NULL */
+	struct buttond_key_stats *stats;
+	/* event to read latency of last event, -1 if none */
+	int64_t read_latency;
+	/* when state last changed, for stats */
+	struct timespec ts_state;
+
+	/* when key was pressed - valid for state == BUTTOND_KEY_PRESSED or
+	 * BUTTOND_KEY_DEBOUNCE */
+	struct timeval tv_pressed;
+	/* valid when BUTTOND_KEY_DEBOUNCE */
+	struct timeval tv_released;
+	/* when next to wakeup, if armed */
+	struct buttond_timer wakeup;
+
+	/* state machine:
+	 * - RELEASED/PRESSED state
+	 * - DEBOUNCE: immediately after being released for DEBOUNCE_MSECS
+	 * - HANDLED: long press already handled (ignore until release)
+	 * - TAPPED: released in a sequence, waiting for the next tap
+	 */
+	enum buttond_key_state {
+		BUTTOND_KEY_RELEASED,
+		BUTTOND_KEY_PRESSED,
+		BUTTOND_KEY_DEBOUNCE,
+		BUTTOND_KEY_HANDLED,
+		BUTTOND_KEY_TAPPED,
+	} state;
+};
+
+struct buttond_tap_node {
+	/* node after a short or long tap, 0 if no sequence goes on so */
+	uint16_t next[2];
+	/* index in key actions of the sequence ending here, -1 if none */
+	int16_t action;
+	/* max time to wait for the next tap */
+	int gap_msecs;
+};
+
+_Static_assert(BUTTOND_KEY_TAPPED + 1 == BUTTOND_STATS_KEY_STATES,
+	       "key states and stats do not match");
+
+struct buttond;
+
+struct buttond_ops {
+	/* action matched for key, held for held ms.
+	 * Also called for actions with exit_after set or without command
+	 * (action->action empty), e.g. exit timeout (key code 0) */
+	void (*action)(struct buttond *bd, struct buttond_key *key,
+		       struct buttond_action *action, int64_t held);
+	/* optional messages: level 0 is an error, higher levels are
+	 * increasingly verbose like -v */
+	void (*log)(struct buttond *bd, int level, const char *fmt,
+		    va_list ap);
+};
+
+struct buttond {
+	const struct buttond_ops *ops;
+
+	struct buttond_key *keys;
+	int key_count;
+	int key_alloc;
+	int debounce_msecs;
+	/* keys, their actions and timers are static tables (see buttond
+	 * --emit-c): already checked, never grown nor freed */
+	bool static_keys;
+
+	/* time given to the last call */
+	struct timespec now;
+
+	/* stats buttond_start allocated for keys without, freed by
+	 * buttond_free */
+	struct buttond_key_stats *stats;
+
+	/* timers heap, see timer.c. Allocated for one timer per key
+	 * by buttond_start */
+	struct buttond_timer **timers;
+	int timer_count;
+	uint64_t timer_seq;
+
+	/* chords: keys in chords currently down, by their chord_bit, and
+	 * key code of each bit */
+	uint64_t keys_down;
+	int chord_count;
+	int chord_key_count;
+	uint16_t chord_keys[BUTTOND_MAX_CHORD_KEYS];
+
+	/* lookup tables by key code:
+	 * - key_index is index in keys + 1, 0 if key is not configured.
+	 *   Updated as keys are added. Also has chords after keys.
+	 * - key_bitmap has a bit set for each key we handle events for,
+	 *   built by buttond_start (does not include special key 0)
+	 */
+	uint16_t key_index[KEY_CNT + BUTTOND_MAX_CHORDS];
+	unsigned char key_bitmap[KEY_CNT / 8];
+};
+
+static inline struct buttond_key *buttond_key_by_code(struct buttond *bd, uint16_t code) {
+	if (code >= KEY_CNT + BUTTOND_MAX_CHORDS || !bd->key_index[code])
+		return NULL;
+	return &bd->keys[bd->key_index[code] - 1];
+}
+
+/* setup: add actions, then start.
+ * buttond_add_action returns NULL on allocation failure, the action
+ * defaults to a short press of 1s to be filled by caller.
+ * A BUTTOND_SEQUENCE action runs when the key is tapped as in its taps, each
+ * tap being long if held at least as long as the key's shortest short
+ * press time (default 1s). Short and long actions of the key then
+ * only run for a single press, once no sequence can follow it.
+ * Code 0 is a timeout since start (a long press that is always held).
+ * buttond_check sorts actions and returns -1 if they are inconsistent
+ * (logged). buttond_start checks then arms exit timeouts, it also
+ * returns -1 on allocation failure. */
+struct buttond_action *buttond_add_action(struct buttond *bd, uint16_t code);
+/* same for a chord of count keys, held together: it is pressed when
+ * the last of them goes down and released when the first goes up.
+ * Once a chord is pressed actions of its keys, and of chords made of
+ * some of its keys, are not run until these are released.
+ * Keys are added without action if they have none, and adding another
+ * action for the same keys in any order adds it to the same chord.
+ * Returns NULL with errno ENOSPC if there would be more than
+ * BUTTOND_MAX_CHORDS chords or BUTTOND_MAX_CHORD_KEYS keys in them,
+ * EINVAL if there are less than two distinct keys. */
+struct buttond_action *buttond_add_chord(struct buttond *bd, const uint16_t *codes,
+					 int count);
+/* add an action to bd for the same key or chord as key of from, e.g.
+ * when building new bindings from existing ones */
+struct buttond_action *buttond_add_key_action(struct buttond *bd,
+					      struct buttond *from, struct buttond_key *key);
+/* key or chord of bd that is the same as key of another buttond, if any */
+struct buttond_key *buttond_same_key(struct buttond *bd, struct buttond_key *key);
+/* optional: make room for key_count keys at once, -1 on allocation
+ * failure */
+int buttond_reserve(struct buttond *bd, int key_count);
+int buttond_check(struct buttond *bd);
+int buttond_start(struct buttond *bd, const struct timespec *now);
+
+/* reconfiguration: next is built with buttond_add_action (and given
+ * stats) like for start, and checked with buttond_check.
+ * buttond_reload swaps it in: keys present in both (for chords, made
+ * of the same keys) keep their state, so a key being held stays held
+ * with its timer re-armed for the new actions, and a key being
+ * debounced is decided at the same time. Sequences in progress are
+ * dropped.
+ * next then holds the previous keys, which caller can still look at
+ * to update its own references before buttond_free(next).
+ * Returns -1 on allocation failure, nothing is changed then.
+ * Action commands are not freed: they belong to the caller. */
+int buttond_reload(struct buttond *bd, struct buttond *next,
+		   const struct timespec *now);
+void buttond_free(struct buttond *bd);
+
+/* events: non-key events and keys without actions are ignored, in
+ * which case buttond_handle_event returns false.
+ * buttond_handle_key is the same for callers that already looked the
+ * key up, buttond_key_pressed is for a key found already pressed (e.g.
+ * EVIOCGKEY after open) and buttond_key_released for one found
+ * released while it was held (e.g. EVIOCGKEY after SYN_DROPPED): as
+ * the release time is not known no action is run for that press. */
+bool buttond_handle_event(struct buttond *bd, struct input_event *event,
+			  const struct timespec *now);
+void buttond_handle_key(struct buttond *bd, struct input_event *event,
+			struct buttond_key *key, const struct timespec *now);
+void buttond_key_pressed(struct buttond *bd, struct buttond_key *key,
+			 const struct timespec *now);
+void buttond_key_released(struct buttond *bd, struct buttond_key *key,
+			  const struct timespec *now);
+
+/* time: next_timeout returns false if nothing is scheduled */
+bool buttond_next_timeout(struct buttond *bd, struct timespec *ts);
+void buttond_handle_timeouts(struct buttond *bd, const struct timespec *now);
+
+/* code names, without prefix (e.g. "POWER" for KEY_POWER), for EV_KEY,
+ * EV_SW and EV_ABS. Lookups are case insensitive and use a hash table
+ * generated at build time.
+ * buttond_event_code_by_name returns -1 and buttond_event_code_name
+ * NULL if unknown, buttond_find_key_by_name 0 and
+ * buttond_keyname_by_code "unknown". */
+int buttond_event_code_by_name(uint16_t type, const char *name);
+const char *buttond_event_code_name(uint16_t type, uint16_t code);
+uint16_t buttond_find_key_by_name(const char *name);
+const char *buttond_keyname_by_code(uint16_t code);
+
+static inline const char *buttond_key_name(struct buttond_key *key) {
+	return key->name ? key->name : buttond_keyname_by_code(key->code);
+}
+
+/* statistics */
+void buttond_stats_latency(struct buttond_key *key, enum buttond_latency latency,
+			   int64_t nsecs);
+
+#endif
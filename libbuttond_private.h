@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LIBBUTTOND_PRIVATE_H
+#define LIBBUTTOND_PRIVATE_H
+
+/* internal to the library, not installed */
+
+#include "libbuttond.h"
+
+static inline bool timer_armed(struct buttond_timer *timer) {
+	return timer->heap_pos >= 0;
+}
+
+void arm_key_press(struct buttond *bd, struct buttond_key *key, bool reset_pressed);
+void key_set_state(struct buttond *bd, struct buttond_key *key,
+		   enum buttond_key_state new_state);
+void timer_arm(struct buttond *bd, struct buttond_timer *timer,
+	       struct timespec *ts);
+void timer_cancel(struct buttond *bd, struct buttond_timer *timer);
+struct buttond_timer *timer_pop_expired(struct buttond *bd);
+
+#endif
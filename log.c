@@ -0,0 +1,527 @@
+// SPDX-License-Identifier: MIT
+
+/* -v messages, kept off the event path.
+ *
+ * log_printf only copies its format pointer and arguments (and strings
+ * they point to) into a preallocated ring: formatting and writing
+ * happen in log_flush, once per main loop iteration, to a non-blocking
+ * fd. When the sink cannot keep up the ring fills, further messages
+ * are dropped and counted, and a line says how many once there is room
+ * again. Pending messages are written out blocking on exit.
+ *
+ * With --log-binary, records are written as is instead of formatted,
+ * each format string once before the first record using it, and
+ * buttond --decode-log <file> prints them later as text. Binary logs
+ * are appended to like text ones, each start with its own header.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+
+#include "buttond.h"
+
+#define LOG_RING_SIZE (64 * 1024)
+/* formatted text waiting for the sink */
+#define LOG_OUT_SIZE 4096
+#define LOG_MAX_ARGS 12
+/* distinct formats in binary logs, there are far fewer */
+#define LOG_MAX_FORMATS 512
+
+#define LOG_MAGIC 0x474c4442 /* "BDLG" */
+#define LOG_VERSION 1
+
+enum log_record_type {
+	/* rest of ring up to its end is unused */
+	LOG_PAD,
+	LOG_MESSAGE,
+	/* binary log only: format string, NUL terminated */
+	LOG_FORMAT,
+};
+
+/* in the ring, format is the format string pointer. In binary logs it
+ * is an index in the format records that came before */
+struct log_record {
+	/* whole record including strings, multiple of 8 */
+	uint16_t size;
+	uint8_t type;
+	uint8_t nargs;
+	uint32_t pad;
+	uint64_t format;
+	/* integers, or string length including NUL for %s and %m: strings
+	 * follow args in order */
+	uint64_t args[];
+};
+
+/* what each conversion takes */
+enum log_arg {
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_STRING,
+	ARG_ERRNO,
+	ARG_PTR,
+	ARG_INVALID,
+};
+
+static struct {
+	/* records in [tail, head), positions grow forever */
+	uint64_t head;
+	uint64_t tail;
+	uint64_t dropped;
+	uint64_t dropped_total;
+	_Alignas(8) unsigned char ring[LOG_RING_SIZE];
+
+	/* sink, -1 until log_init if not stdout */
+	int fd;
+	bool binary;
+	/* waiting for POLLOUT */
+	bool added;
+	struct event_source source;
+	/* bytes of out still to write */
+	char out[LOG_OUT_SIZE];
+	size_t out_pos;
+	size_t out_len;
+
+	/* binary: formats already written, by pointer */
+	const char *formats[LOG_MAX_FORMATS];
+	int format_count;
+} logger = {
+	.fd = STDOUT_FILENO,
+};
+
+/* length modifier and conversion of a conversion spec starting after
+ * %, *len is set to the spec length */
+static enum log_arg parse_spec(const char *spec, size_t *len) {
+	const char *c = spec;
+	int longs = 0;
+	bool size = false;
+
+	c += strspn(c, "-+ #0123456789.");
+	for (; *c == 'l' || *c == 'h' || *c == 'z'; c++) {
+		if (*c == 'l')
+			longs++;
+		if (*c == 'z')
+			size = true;
+	}
+	*len = c + 1 - spec;
+	switch (*c) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+	case 'c':
+		if (size)
+			return ARG_SIZE;
+		return longs == 0 ? ARG_INT : longs == 1 ? ARG_LONG : ARG_LLONG;
+	case 's':
+		return ARG_STRING;
+	case 'm':
+		return ARG_ERRNO;
+	case 'p':
+		return ARG_PTR;
+	}
+	return ARG_INVALID;
+}
+
+/* room for size bytes in the ring, NULL if full */
+static struct log_record *ring_reserve(size_t size) {
+	size_t pos = logger.head % LOG_RING_SIZE;
+	size_t end = LOG_RING_SIZE - pos;
+
+	if (size > end) {
+		/* records do not wrap: pad until end of ring */
+		if (logger.head + end + size - logger.tail > LOG_RING_SIZE)
+			return NULL;
+		((struct log_record *)&logger.ring[pos])->type = LOG_PAD;
+		((struct log_record *)&logger.ring[pos])->size = 0;
+		logger.head += end;
+		pos = 0;
+	}
+	if (logger.head + size - logger.tail > LOG_RING_SIZE)
+		return NULL;
+	return (struct log_record *)&logger.ring[pos];
+}
+
+void log_vprintf(const char *fmt, va_list ap) {
+	const char *strings[LOG_MAX_ARGS];
+	uint64_t args[LOG_MAX_ARGS];
+	struct log_record *record;
+	int nargs = 0, saved_errno = errno;
+	size_t size, len;
+	char *dest;
+
+	for (const char *c = fmt; (c = strchr(c, '%')); c += len) {
+		c++;
+		if (*c == '%') {
+			len = 1;
+			continue;
+		}
+		enum log_arg arg = parse_spec(c, &len);
+
+		xassert(arg != ARG_INVALID && nargs < LOG_MAX_ARGS,
+			"Unsupported log format %s", fmt);
+		strings[nargs] = NULL;
+		switch (arg) {
+		case ARG_INT:
+			args[nargs] = va_arg(ap, int);
+			break;
+		case ARG_LONG:
+			args[nargs] = va_arg(ap, long);
+			break;
+		case ARG_LLONG:
+			args[nargs] = va_arg(ap, long long);
+			break;
+		case ARG_SIZE:
+			args[nargs] = va_arg(ap, size_t);
+			break;
+		case ARG_PTR:
+			args[nargs] = (uintptr_t)va_arg(ap, void *);
+			break;
+		case ARG_STRING:
+			strings[nargs] = va_arg(ap, const char *);
+			if (!strings[nargs])
+				strings[nargs] = "(null)";
+			break;
+		case ARG_ERRNO:
+			strings[nargs] = strerror(saved_errno);
+			break;
+		case ARG_INVALID:
+			break;
+		}
+		nargs++;
+	}
+
+	size = sizeof(*record) + nargs * sizeof(args[0]);
+	for (int i = 0; i < nargs; i++) {
+		if (strings[i]) {
+			args[i] = strlen(strings[i]) + 1;
+			size += args[i];
+		}
+	}
+	size = (size + 7) & ~(size_t)7;
+	if (size > UINT16_MAX || !(record = ring_reserve(size))) {
+		logger.dropped++;
+		logger.dropped_total++;
+		errno = saved_errno;
+		return;
+	}
+
+	record->size = size;
+	record->type = LOG_MESSAGE;
+	record->nargs = nargs;
+	record->format = (uintptr_t)fmt;
+	memcpy(record->args, args, nargs * sizeof(args[0]));
+	dest = (char *)&record->args[nargs];
+	for (int i = 0; i < nargs; i++) {
+		if (strings[i]) {
+			memcpy(dest, strings[i], args[i]);
+			dest += args[i];
+		}
+	}
+	logger.head += size;
+	errno = saved_errno;
+}
+
+void log_printf(const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	log_vprintf(fmt, ap);
+	va_end(ap);
+}
+
+/* format record into buf, returns the length it needed like snprintf */
+static size_t format_record(struct log_record *record, const char *fmt,
+			    char *buf, size_t size) {
+	const char *string = (const char *)&record->args[record->nargs];
+	size_t out = 0, len;
+	int arg = 0;
+	char spec[32];
+
+#define OUT(...) do { \
+	int n = snprintf(buf + (out < size ? out : size), \
+			 out < size ? size - out : 0, __VA_ARGS__); \
+	out += n > 0 ? n : 0; \
+} while (0)
+
+	while (*fmt) {
+		const char *c = strchr(fmt, '%');
+
+		if (!c) {
+			OUT("%s", fmt);
+			break;
+		}
+		OUT("%.*s", (int)(c - fmt), fmt);
+		if (c[1] == '%') {
+			OUT("%%");
+			fmt = c + 2;
+			continue;
+		}
+		enum log_arg type = parse_spec(c + 1, &len);
+
+		fmt = c + 1 + len;
+		if (arg >= record->nargs || len + 2 > sizeof(spec)) {
+			/* broken binary log */
+			OUT("?");
+			continue;
+		}
+		memcpy(spec, c, len + 1);
+		spec[len + 1] = 0;
+		uint64_t value = record->args[arg++];
+
+		switch (type) {
+		case ARG_INT:
+			OUT(spec, (int)value);
+			break;
+		case ARG_LONG:
+			OUT(spec, (long)value);
+			break;
+		case ARG_LLONG:
+			OUT(spec, (long long)value);
+			break;
+		case ARG_SIZE:
+			OUT(spec, (size_t)value);
+			break;
+		case ARG_PTR:
+			OUT(spec, (void *)(uintptr_t)value);
+			break;
+		case ARG_ERRNO:
+			spec[len] = 's';
+			/* fallthrough */
+		case ARG_STRING:
+			OUT(spec, string);
+			string += value;
+			break;
+		case ARG_INVALID:
+			OUT("?");
+			break;
+		}
+	}
+#undef OUT
+	return out;
+}
+
+/* binary: index of format, written first if new. -1 if out has no
+ * room */
+static int binary_format(const char *fmt) {
+	struct log_record *record;
+	size_t len, size;
+	int i;
+
+	for (i = 0; i < logger.format_count; i++)
+		if (logger.formats[i] == fmt)
+			return i;
+	xassert(i < LOG_MAX_FORMATS, "Too many log formats");
+	len = strlen(fmt) + 1;
+	size = (sizeof(*record) + len + 7) & ~(size_t)7;
+	if (logger.out_len + size > sizeof(logger.out))
+		return -1;
+	record = (struct log_record *)&logger.out[logger.out_len];
+	memset(record, 0, size);
+	record->size = size;
+	record->type = LOG_FORMAT;
+	record->format = i;
+	memcpy(record->args, fmt, len);
+	logger.out_len += size;
+	logger.formats[logger.format_count++] = fmt;
+	return i;
+}
+
+/* move records from ring to out while they fit */
+static void fill_out(void) {
+	if (logger.out_pos == logger.out_len)
+		logger.out_pos = logger.out_len = 0;
+
+	while (logger.tail != logger.head) {
+		struct log_record *record = (struct log_record *)
+			&logger.ring[logger.tail % LOG_RING_SIZE];
+		size_t room = sizeof(logger.out) - logger.out_len;
+
+		if (record->type == LOG_PAD) {
+			logger.tail += LOG_RING_SIZE - logger.tail % LOG_RING_SIZE;
+			continue;
+		}
+		if (logger.binary) {
+			int format = binary_format((const char *)(uintptr_t)record->format);
+
+			room = sizeof(logger.out) - logger.out_len;
+			if (format < 0 || record->size > room)
+				return;
+			memcpy(&logger.out[logger.out_len], record, record->size);
+			((struct log_record *)&logger.out[logger.out_len])->format
+				= format;
+			logger.out_len += record->size;
+		} else {
+			size_t len = format_record(record,
+					(const char *)(uintptr_t)record->format,
+					&logger.out[logger.out_len], room);
+
+			/* full: try again with an emptier out, unless
+			 * it is too long anyway and gets truncated */
+			if (len >= room && logger.out_len)
+				return;
+			logger.out_len += len < room ? len : room - 1;
+		}
+		logger.tail += record->size;
+	}
+}
+
+static void log_want_write(struct state *state, bool want) {
+	if (want == logger.added)
+		return;
+	logger.added = want;
+	logger.source.want_write = want;
+	if (want)
+		loop_add(state, &logger.source);
+	else
+		loop_del(state, &logger.source);
+}
+
+void log_flush(struct state *state) {
+	while (1) {
+		if (logger.out_pos == logger.out_len) {
+			fill_out();
+			if (logger.out_pos == logger.out_len)
+				break;
+		}
+		ssize_t n = write(logger.fd, logger.out + logger.out_pos,
+				  logger.out_len - logger.out_pos);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno == EAGAIN && state) {
+			log_want_write(state, true);
+			return;
+		}
+		if (n <= 0) {
+			/* nowhere to log to: drop everything */
+			logger.tail = logger.head;
+			logger.out_pos = logger.out_len = 0;
+			break;
+		}
+		logger.out_pos += n;
+	}
+	if (state)
+		log_want_write(state, false);
+	if (logger.dropped) {
+		uint64_t dropped = logger.dropped;
+
+		logger.dropped = 0;
+		log_printf("[%"PRIu64" log messages dropped]\n", dropped);
+	}
+	if (state && state->stats)
+		state->stats->log_dropped = logger.dropped_total;
+}
+
+void log_writable(struct state *state, uint32_t events) {
+	(void)events;
+	log_flush(state);
+}
+
+/* everything left, blocking */
+static void log_exit(void) {
+	if (logger.fd < 0)
+		return;
+	fcntl(logger.fd, F_SETFL, fcntl(logger.fd, F_GETFL) & ~O_NONBLOCK);
+	log_flush(NULL);
+}
+
+void log_init(struct state *state) {
+	struct stat sb;
+	int fd;
+
+	logger.source.type = SOURCE_LOG;
+	logger.binary = state->log_binary;
+	if (state->log_path) {
+		fd = open(state->log_path,
+			  O_WRONLY | O_CREAT | O_APPEND | O_NONBLOCK | O_CLOEXEC,
+			  0644);
+		xassert(fd >= 0, "Could not open %s: %m", state->log_path);
+	} else if (fstat(STDOUT_FILENO, &sb) == 0 && S_ISREG(sb.st_mode)) {
+		/* files do not block, and cannot be polled */
+		fd = STDOUT_FILENO;
+	} else {
+		/* own open file description, as O_NONBLOCK on stdout's
+		 * would also apply to actions sharing it */
+		fd = open("/proc/self/fd/1", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0)
+			fd = STDOUT_FILENO;
+	}
+	if (fd != STDOUT_FILENO && fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode))
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+	/* messages logged before go to the new sink */
+	logger.fd = fd;
+	logger.source.fd = fd;
+	if (logger.binary) {
+		uint32_t header[2] = { LOG_MAGIC, LOG_VERSION };
+
+		xassert(write(fd, header, sizeof(header)) == sizeof(header),
+			"Could not write log header: %m");
+	}
+	atexit(log_exit);
+}
+
+int log_decode(const char *path) {
+	const char *formats[LOG_MAX_FORMATS] = { 0 };
+	char text[LOG_OUT_SIZE];
+	struct log_record *record;
+	uint32_t *header;
+	struct stat sb;
+	size_t pos;
+	char *buf;
+	int fd;
+	ssize_t n;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	xassert(fd >= 0, "Could not open %s: %m", path);
+	xassert(fstat(fd, &sb) == 0, "Could not stat %s: %m", path);
+	/* records are read in place, keep them aligned */
+	buf = xcalloc(1, sb.st_size + 8);
+	n = read_safe(fd, buf, sb.st_size);
+	xassert(n == sb.st_size, "Could not read %s", path);
+	close(fd);
+
+	header = (uint32_t *)buf;
+	xassert(n >= 8 && header[0] == LOG_MAGIC && header[1] == LOG_VERSION,
+		"%s is not a buttond binary log", path);
+	for (pos = 8; pos + 8 <= (size_t)n; ) {
+		/* header again: a later start appended to the log, its
+		 * format indexes start over. Never a record, as it would
+		 * have an invalid type */
+		header = (uint32_t *)&buf[pos];
+		if (header[0] == LOG_MAGIC && header[1] == LOG_VERSION) {
+			memset(formats, 0, sizeof(formats));
+			pos += 8;
+			continue;
+		}
+		record = (struct log_record *)&buf[pos];
+		if (pos + sizeof(*record) > (size_t)n
+		    || record->size < sizeof(*record) || pos + record->size > (size_t)n
+		    || record->format >= LOG_MAX_FORMATS) {
+			fprintf(stderr, "%s: truncated or corrupted at %zu\n",
+				path, pos);
+			return 1;
+		}
+		pos += record->size;
+		if (record->type == LOG_FORMAT) {
+			/* NUL terminated by padding */
+			formats[record->format] = (const char *)record->args;
+			continue;
+		}
+		const char *fmt = formats[record->format];
+
+		if (!fmt) {
+			printf("[unknown format %"PRIu64"]\n", record->format);
+			continue;
+		}
+		format_record(record, fmt, text, sizeof(text));
+		fputs(text, stdout);
+	}
+	return 0;
+}
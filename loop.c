@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: MIT
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "buttond.h"
+
+void loop_init(struct state *state) {
+	state->epoll_fd = -1;
+#ifdef HAVE_IO_URING
+	if (uring_init(state))
+		return;
+#endif
+	state->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	xassert(state->epoll_fd >= 0, "Could not create epoll fd: %m");
+}
+
+/* signals are handled through signalfd in main loop:
+ * - SIGCHLD for actions exit
+ * - SIGUSR1 to dump statistics */
+void signals_init(struct state *state) {
+	sigset_t mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGUSR1);
+	xassert(sigprocmask(SIG_BLOCK, &mask, NULL) == 0,
+		"Could not block signals: %m");
+	state->signal.type = SOURCE_SIGNAL;
+	state->signal.fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	xassert(state->signal.fd >= 0, "Could not create signalfd: %m");
+	loop_add(state, &state->signal);
+}
+
+void handle_signals(struct state *state) {
+	struct signalfd_siginfo info[16];
+	bool child = false, dump = false;
+	int n;
+
+	while ((n = read_safe(state->signal.fd, info, sizeof(info))) > 0) {
+		for (size_t i = 0; i < n / sizeof(info[0]); i++) {
+			if (info[i].ssi_signo == SIGCHLD)
+				child = true;
+			else if (info[i].ssi_signo == SIGUSR1)
+				dump = true;
+		}
+		if (n < (int)sizeof(info))
+			break;
+	}
+	if (child)
+		exec_reap(state);
+	if (dump)
+		stats_dump(state->stats, stdout);
+}
+
+/* key timers are kept in the library heap, the earliest one (or
+ * earliest --time-limit) is programmed in a single timerfd */
+void timer_init(struct state *state) {
+	state->timer.type = SOURCE_TIMER;
+	state->timer.fd = timerfd_create(CLOCK_MONOTONIC,
+					 TFD_NONBLOCK | TFD_CLOEXEC);
+	xassert(state->timer.fd >= 0, "Could not create timerfd: %m");
+	loop_add(state, &state->timer);
+}
+
+
+/* timerfd went off: clear it so we don't wake up for it again */
+void timer_clear(struct state *state) {
+	uint64_t expirations;
+
+	read_safe(state->timer.fd, &expirations, sizeof(expirations));
+	state->timer_fd_armed = false;
+}
+
+void timer_update(struct state *state) {
+	struct itimerspec its = { 0 };
+	struct timespec ts;
+	bool armed;
+
+	/* virtual timers only fire through timer_advance */
+	if (virtual_time)
+		return;
+
+	/* --time-limit deadlines share the timerfd */
+	armed = buttond_next_timeout(&state->bd, &its.it_value);
+	if (exec_next_timeout(state, &ts)
+	    && (!armed || time_cmp_ts(&ts, &its.it_value) < 0)) {
+		its.it_value = ts;
+		armed = true;
+	}
+	if (!armed) {
+		if (!state->timer_fd_armed)
+			return;
+		state->timer_fd_armed = false;
+		if (debug > 3)
+			log_printf("no wakeup scheduled\n");
+	} else {
+		if (state->timer_fd_armed
+		    && time_cmp_ts(&its.it_value, &state->timer_fd_ts) == 0)
+			return;
+		state->timer_fd_armed = true;
+		state->timer_fd_ts = its.it_value;
+		if (debug > 3)
+			log_printf("wakeup scheduled in %ld\n",
+				   time_diff_ts(&its.it_value, &state->now));
+	}
+	xassert(timerfd_settime(state->timer.fd, TFD_TIMER_ABSTIME, &its, NULL) == 0,
+		"Could not set timerfd: %m");
+}
+
+/* virtual clock: move time to ts, which is the timestamp of an input
+ * event about to be handled, firing timers due until then in order.
+ * Time never goes back: events older than current time (e.g. from
+ * another input) are handled now. */
+void timer_advance(struct state *state, struct timespec *ts) {
+	struct timespec next;
+
+	while (buttond_next_timeout(&state->bd, &next)
+	       && time_cmp_ts(&next, ts) <= 0) {
+		if (time_cmp_ts(&next, &virtual_now) > 0)
+			virtual_now = next;
+		state->now = virtual_now;
+		buttond_handle_timeouts(&state->bd, &state->now);
+	}
+	if (time_cmp_ts(ts, &virtual_now) > 0)
+		virtual_now = *ts;
+	state->now = virtual_now;
+	exec_timeouts(state);
+}
+
+/* log sink is write only */
+static uint32_t source_events(struct event_source *source) {
+	return (source->type != SOURCE_LOG ? EPOLLIN : 0)
+		| (source->want_write ? EPOLLOUT : 0);
+}
+
+void loop_add(struct state *state, struct event_source *source) {
+	struct epoll_event event = {
+		.events = source_events(source),
+		.data.ptr = source,
+	};
+
+#ifdef HAVE_IO_URING
+	if (state->uring) {
+		uring_add(state, source);
+		return;
+	}
+#endif
+
+	xassert(epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, source->fd, &event) == 0,
+		"Could not watch fd %d: %m", source->fd);
+}
+
+void loop_del(struct state *state, struct event_source *source) {
+#ifdef HAVE_IO_URING
+	if (state->uring) {
+		uring_del(state, source);
+		return;
+	}
+#endif
+	xassert(epoll_ctl(state->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL) == 0,
+		"Could not stop watching fd %d: %m", source->fd);
+}
+
+/* source->want_write changed */
+void loop_mod(struct state *state, struct event_source *source) {
+	struct epoll_event event = {
+		.events = source_events(source),
+		.data.ptr = source,
+	};
+
+#ifdef HAVE_IO_URING
+	if (state->uring) {
+		uring_mod(state, source);
+		return;
+	}
+#endif
+	xassert(epoll_ctl(state->epoll_fd, EPOLL_CTL_MOD, source->fd, &event) == 0,
+		"Could not modify watch on fd %d: %m", source->fd);
+}
+
+static void handle_input_source(struct state *state,
+				struct input_file *input_file,
+				uint32_t events) {
+	/* closed while handling another event of this batch */
+	if (input_file->source.fd < 0)
+		return;
+
+	if (!(events & EPOLLIN)) {
+		input_hangup(state, input_file);
+		if (input_file->source.fd < 0)
+			return;
+	}
+	if (handle_input(state, input_file)) {
+		reopen_input(state, input_file);
+	}
+}
+
+static void dispatch(struct state *state, struct event_source *source,
+		     uint32_t events) {
+	switch (source->type) {
+	case SOURCE_INPUT:
+		handle_input_source(state, (struct input_file *)source, events);
+		break;
+	case SOURCE_INOTIFY:
+		xassert(events & EPOLLIN, "inotify fd went bad");
+		handle_inotify(state);
+		break;
+	case SOURCE_SIGNAL:
+		handle_signals(state);
+		break;
+	case SOURCE_TIMER:
+		timer_clear(state);
+		break;
+	case SOURCE_PUBLISH:
+		publish_accept(state);
+		break;
+	case SOURCE_SUBSCRIBER:
+		publish_subscriber(state, (struct subscriber *)source, events);
+		break;
+	case SOURCE_CONTROL:
+		control_accept(state);
+		break;
+	case SOURCE_CONTROL_CLIENT:
+		control_client(state, (struct control_client *)source, events);
+		break;
+	case SOURCE_LOG:
+		log_writable(state, events);
+		break;
+	}
+}
+
+void loop_run(struct state *state) {
+	struct epoll_event events[16];
+
+#ifdef HAVE_IO_URING
+	if (state->uring)
+		uring_run(state);
+#endif
+
+	while (1) {
+		timer_update(state);
+		int n = epoll_wait(state->epoll_fd, events,
+				   sizeof(events) / sizeof(events[0]), -1);
+		if (n < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		xassert(n >= 0, "epoll_wait failure: %m");
+		time_gettime(&state->now);
+
+		buttond_handle_timeouts(&state->bd, &state->now);
+		exec_timeouts(state);
+		for (int i = 0; i < n; i++)
+			dispatch(state, events[i].data.ptr, events[i].events);
+		publish_flush(state);
+		log_flush(state);
+	}
+}
@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: MIT
+
+/* io_uring main loop, used instead of epoll when built with
+ * HAVE_IO_URING and the kernel lets us create a ring.
+ *
+ * Inputs get a poll linked to a read into the request buffer, so
+ * handling a batch of events and re-arming every source costs a
+ * single io_uring_enter. Other sources (inotify, signalfd, timerfd)
+ * rarely fire and only get a poll, their handlers read as usual.
+ */
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "buttond.h"
+
+#define URING_ENTRIES 256
+/* set in user_data of completions we do not care about */
+#define UDATA_IGNORE 1
+
+struct uring_req {
+	/* NULL once source has been removed, request is freed
+	 * when its completion comes back */
+	struct event_source *source;
+	struct input_event buf[INPUT_BUF_EVENTS];
+};
+
+struct uring {
+	int fd;
+	unsigned int entries;
+	/* submission queue, sq_tail is published on submit */
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int sq_local_tail;
+	unsigned int to_submit;
+	struct io_uring_sqe *sqes;
+	/* completion queue */
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+static int uring_enter(struct uring *ring, unsigned int min_complete) {
+	int rc;
+
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+	rc = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit,
+		     min_complete,
+		     min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	if (rc >= 0)
+		ring->to_submit -= rc;
+	return rc;
+}
+
+static struct io_uring_sqe *get_sqe(struct uring *ring) {
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+	if (ring->sq_local_tail - head >= ring->entries) {
+		/* full: submit what we have without waiting */
+		int rc = uring_enter(ring, 0);
+		xassert(rc >= 0 || errno == EINTR || errno == EBUSY,
+			"io_uring_enter failed: %m");
+		head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		xassert(ring->sq_local_tail - head < ring->entries,
+			"io_uring submission queue still full");
+	}
+
+	unsigned int idx = ring->sq_local_tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	ring->sq_local_tail++;
+	ring->to_submit++;
+	return sqe;
+}
+
+static void post_request(struct uring *ring, struct event_source *source,
+			 struct uring_req *req) {
+	struct io_uring_sqe *sqe = get_sqe(ring);
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = source->fd;
+	sqe->poll32_events = (source->type != SOURCE_LOG ? POLLIN : 0)
+		| (source->want_write ? POLLOUT : 0);
+	if (source->type != SOURCE_INPUT) {
+		sqe->user_data = (uintptr_t)req;
+		return;
+	}
+
+	/* poll result is not interesting, only the read's */
+	sqe->user_data = (uintptr_t)req | UDATA_IGNORE;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe = get_sqe(ring);
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = source->fd;
+	sqe->addr = (uintptr_t)req->buf;
+	sqe->len = sizeof(req->buf);
+	sqe->off = -1;
+	sqe->user_data = (uintptr_t)req;
+}
+
+bool uring_init(struct state *state) {
+	struct io_uring_params params = { 0 };
+	struct uring *ring;
+	int fd;
+
+	fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (fd < 0) {
+		if (debug)
+			log_printf("Could not setup io_uring (%m), using epoll\n");
+		return false;
+	}
+	xassert(params.features & IORING_FEAT_SINGLE_MMAP,
+		"io_uring is too old, need single mmap feature");
+
+	ring = xcalloc(1, sizeof(*ring));
+	ring->fd = fd;
+	ring->entries = params.sq_entries;
+
+	size_t sq_size = params.sq_off.array
+		+ params.sq_entries * sizeof(unsigned int);
+	size_t cq_size = params.cq_off.cqes
+		+ params.cq_entries * sizeof(struct io_uring_cqe);
+	size_t ring_size = sq_size > cq_size ? sq_size : cq_size;
+	char *rings = mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	xassert(rings != MAP_FAILED, "Could not map io_uring rings: %m");
+	ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  fd, IORING_OFF_SQES);
+	xassert(ring->sqes != MAP_FAILED, "Could not map io_uring sqes: %m");
+
+	ring->sq_head = (unsigned int *)(rings + params.sq_off.head);
+	ring->sq_tail = (unsigned int *)(rings + params.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(rings + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(rings + params.sq_off.array);
+	ring->sq_local_tail = *ring->sq_tail;
+	ring->cq_head = (unsigned int *)(rings + params.cq_off.head);
+	ring->cq_tail = (unsigned int *)(rings + params.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(rings + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+
+	state->uring = ring;
+	if (debug > 2)
+		log_printf("using io_uring main loop\n");
+	return true;
+}
+
+void uring_add(struct state *state, struct event_source *source) {
+	struct uring_req *req = xcalloc(1, sizeof(*req));
+
+	req->source = source;
+	source->uring_req = req;
+	post_request(state->uring, source, req);
+}
+
+void uring_del(struct state *state, struct event_source *source) {
+	struct uring_req *req = source->uring_req;
+	struct io_uring_sqe *sqe;
+
+	if (!req)
+		return;
+	/* cancel poll, which also cancels the linked read.
+	 * req is freed when its completion arrives */
+	sqe = get_sqe(state->uring);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = (uintptr_t)req
+		| (source->type == SOURCE_INPUT ? UDATA_IGNORE : 0);
+	sqe->user_data = UDATA_IGNORE;
+	req->source = NULL;
+	source->uring_req = NULL;
+}
+
+/* poll events changed: cancel request and post a new one */
+void uring_mod(struct state *state, struct event_source *source) {
+	uring_del(state, source);
+	uring_add(state, source);
+}
+
+static void handle_input_cqe(struct state *state,
+			     struct input_file *input_file,
+			     struct uring_req *req, int res) {
+	if (res > 0) {
+		if (handle_input_buf(state, input_file, req->buf, res))
+			reopen_input(state, input_file);
+	} else if (res == 0 || res == -ECANCELED) {
+		/* EOF, or the poll was cut short by HUP/ERR */
+		input_hangup(state, input_file);
+	} else if (res != -EAGAIN && res != -EINTR) {
+		fprintf(stderr, "read error: %d. Trying to reopen\n", -res);
+		reopen_input(state, input_file);
+	}
+}
+
+static void handle_cqe(struct state *state, struct io_uring_cqe *cqe) {
+	struct uring_req *req;
+	struct event_source *source;
+
+	if (cqe->user_data & UDATA_IGNORE)
+		return;
+	req = (struct uring_req *)(uintptr_t)cqe->user_data;
+	source = req->source;
+	if (!source) {
+		free(req);
+		return;
+	}
+
+	switch (source->type) {
+	case SOURCE_INPUT:
+		handle_input_cqe(state, (struct input_file *)source, req,
+				 cqe->res);
+		break;
+	case SOURCE_INOTIFY:
+		xassert(cqe->res > 0 && (cqe->res & POLLIN),
+			"inotify fd went bad");
+		handle_inotify(state);
+		break;
+	case SOURCE_SIGNAL:
+		handle_signals(state);
+		break;
+	case SOURCE_TIMER:
+		timer_clear(state);
+		break;
+	case SOURCE_PUBLISH:
+		publish_accept(state);
+		break;
+	case SOURCE_SUBSCRIBER:
+		/* poll returns revents, same bits as epoll */
+		publish_subscriber(state, (struct subscriber *)source,
+				   cqe->res < 0 ? EPOLLERR : cqe->res);
+		break;
+	case SOURCE_CONTROL:
+		control_accept(state);
+		break;
+	case SOURCE_CONTROL_CLIENT:
+		control_client(state, (struct control_client *)source,
+			       cqe->res < 0 ? EPOLLERR : cqe->res);
+		break;
+	case SOURCE_LOG:
+		log_writable(state, cqe->res < 0 ? EPOLLERR : cqe->res);
+		break;
+	}
+
+	/* handler might have removed the source (reopen) */
+	if (!req->source) {
+		free(req);
+		return;
+	}
+	post_request(state->uring, source, req);
+}
+
+void uring_run(struct state *state) {
+	struct uring *ring = state->uring;
+
+	while (1) {
+		timer_update(state);
+		int n = uring_enter(ring, 1);
+		if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+			continue;
+		xassert(n >= 0, "io_uring_enter failure: %m");
+		time_gettime(&state->now);
+
+		buttond_handle_timeouts(&state->bd, &state->now);
+		exec_timeouts(state);
+		unsigned int head = *ring->cq_head;
+		unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+			/* release the slot before handling, so handlers
+			 * submitting more requests do not overflow */
+			head++;
+			__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+			handle_cqe(state, &cqe);
+		}
+		publish_flush(state);
+		log_flush(state);
+	}
+}
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: MIT
+
+/* --publish: fan-out of key events and decisions to any number of
+ * subscribers on a unix socket, see publish.h for the protocol.
+ *
+ * Each subscriber has its own ring. Messages are queued there while
+ * handling a loop iteration and sent once at its end by publish_flush,
+ * in a single sendmsg per subscriber. A subscriber that does not keep
+ * up is polled for POLLOUT while its ring drains, and messages that do
+ * not fit are dropped and counted: it is sent a PUBLISH_DROPPED message
+ * once there is room again. The main loop never blocks on a client.
+ */
+
+/* accept4, meson already sets it */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "buttond.h"
+#include "publish.h"
+
+/* must be a multiple of message size so they never wrap */
+#define RING_SIZE 4096
+_Static_assert(RING_SIZE % sizeof(struct publish_msg) == 0,
+	       "ring would split messages");
+
+struct subscriber {
+	/* must be first: loop hands us back the source */
+	struct event_source source;
+	/* free running byte offsets: ring holds [head, tail) */
+	uint32_t head;
+	uint32_t tail;
+	/* messages dropped since last PUBLISH_DROPPED was queued */
+	uint32_t dropped;
+	char ring[RING_SIZE];
+};
+
+/* listening unix stream socket, also used for --control.
+ * owner_only: socket mode is 0600 whatever the umask, connecting
+ * needs write access */
+int unix_listen(const char *path, bool owner_only) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	mode_t umask_saved = 0;
+	int fd, rc;
+
+	xassert(strlen(path) < sizeof(addr.sun_path),
+		"Socket path too long: %s", path);
+	strcpy(addr.sun_path, path);
+	/* stale socket from a previous run */
+	unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	xassert(fd >= 0, "Could not create socket: %m");
+	/* bind creates the socket file with the umask applied */
+	if (owner_only)
+		umask_saved = umask(0177);
+	rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	if (owner_only)
+		umask(umask_saved);
+	xassert(rc == 0, "Could not bind %s: %m", path);
+	xassert(listen(fd, 16) == 0, "Could not listen on %s: %m", path);
+	return fd;
+}
+
+void publish_init(struct state *state) {
+	if (!state->publish_path)
+		return;
+
+	state->publish.type = SOURCE_PUBLISH;
+	state->publish.fd = unix_listen(state->publish_path, false);
+	loop_add(state, &state->publish);
+}
+
+static void subscriber_close(struct state *state, int idx) {
+	struct subscriber *sub = state->subscribers[idx];
+
+	if (debug > 1)
+		log_printf("subscriber %d left\n", sub->source.fd);
+	loop_del(state, &sub->source);
+	close(sub->source.fd);
+	free(sub);
+	state->subscribers[idx] = state->subscribers[--state->subscriber_count];
+	state->stats->subscribers = state->subscriber_count;
+}
+
+void publish_accept(struct state *state) {
+	int fd;
+
+	while ((fd = accept4(state->publish.fd, NULL, NULL,
+			     SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+		struct subscriber *sub = xcalloc(1, sizeof(*sub));
+
+		sub->source.type = SOURCE_SUBSCRIBER;
+		sub->source.fd = fd;
+		if (state->subscriber_count == state->subscriber_alloc) {
+			state->subscriber_alloc = state->subscriber_alloc
+				? state->subscriber_alloc * 2 : 4;
+			state->subscribers = xreallocarray(state->subscribers,
+					state->subscriber_alloc,
+					sizeof(*state->subscribers));
+		}
+		state->subscribers[state->subscriber_count++] = sub;
+		state->stats->subscribers = state->subscriber_count;
+		loop_add(state, &sub->source);
+		if (debug > 1)
+			log_printf("new subscriber %d\n", fd);
+	}
+	xassert(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR
+		|| errno == ECONNABORTED,
+		"Could not accept subscriber: %m");
+}
+
+/* send as much of the ring as the socket takes.
+ * Return -1 if subscriber is gone */
+static int subscriber_send(struct state *state, struct subscriber *sub) {
+	while (sub->head != sub->tail) {
+		uint32_t off = sub->head % RING_SIZE;
+		uint32_t len = sub->tail - sub->head;
+		struct iovec iov[2] = {
+			{ .iov_base = sub->ring + off },
+			{ .iov_base = sub->ring },
+		};
+		struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 1 };
+
+		if (off + len > RING_SIZE) {
+			iov[0].iov_len = RING_SIZE - off;
+			iov[1].iov_len = len - iov[0].iov_len;
+			msg.msg_iovlen = 2;
+		} else {
+			iov[0].iov_len = len;
+		}
+		ssize_t n = sendmsg(sub->source.fd, &msg,
+				    MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			/* wait until it can take more */
+			if (!sub->source.want_write) {
+				sub->source.want_write = true;
+				loop_mod(state, &sub->source);
+			}
+			return 0;
+		}
+		if (n < 0)
+			return -1;
+		sub->head += n;
+	}
+	if (sub->source.want_write) {
+		sub->source.want_write = false;
+		loop_mod(state, &sub->source);
+	}
+	return 0;
+}
+
+void publish_subscriber(struct state *state, struct subscriber *sub,
+			uint32_t events) {
+	int idx;
+
+	for (idx = 0; idx < state->subscriber_count; idx++)
+		if (state->subscribers[idx] == sub)
+			break;
+
+	if (events & EPOLLIN) {
+		/* subscribers have nothing to say: data or EOF means
+		 * they are going away */
+		char buf[64];
+		ssize_t n = read(sub->source.fd, buf, sizeof(buf));
+		if (n >= 0 || (errno != EAGAIN && errno != EINTR)) {
+			subscriber_close(state, idx);
+			return;
+		}
+	}
+	if (events & (EPOLLHUP | EPOLLERR)) {
+		subscriber_close(state, idx);
+		return;
+	}
+	if ((events & EPOLLOUT) && subscriber_send(state, sub) < 0)
+		subscriber_close(state, idx);
+}
+
+static bool ring_push(struct subscriber *sub, struct publish_msg *msg) {
+	if (RING_SIZE - (sub->tail - sub->head) < sizeof(*msg))
+		return false;
+	memcpy(sub->ring + sub->tail % RING_SIZE, msg, sizeof(*msg));
+	sub->tail += sizeof(*msg);
+	return true;
+}
+
+static void publish(struct state *state, struct publish_msg *msg) {
+	if (state->shmring)
+		shmring_push(state, msg);
+	for (int i = 0; i < state->subscriber_count; i++) {
+		struct subscriber *sub = state->subscribers[i];
+
+		if (sub->dropped) {
+			struct publish_msg dropped = {
+				.time_usecs = msg->time_usecs,
+				.type = PUBLISH_DROPPED,
+				.value = sub->dropped,
+			};
+			/* only report once the new message also fits */
+			if (RING_SIZE - (sub->tail - sub->head)
+					>= 2 * sizeof(*msg)) {
+				ring_push(sub, &dropped);
+				sub->dropped = 0;
+			}
+		}
+		if (sub->dropped || !ring_push(sub, msg)) {
+			sub->dropped++;
+			state->stats->publish_dropped++;
+			continue;
+		}
+		state->stats->published++;
+	}
+	state->publish_pending = true;
+}
+
+void publish_key(struct state *state, struct input_event *event) {
+	struct publish_msg msg = {
+		.time_usecs = (uint64_t)event->input_event_sec * USECS_IN_SEC
+			+ event->input_event_usec,
+		.type = PUBLISH_KEY,
+		.code = event->code,
+		.value = event->value,
+	};
+
+	publish(state, &msg);
+}
+
+void publish_action(struct state *state, struct buttond_key *key,
+		    struct buttond_action *action, int64_t held) {
+	struct publish_msg msg = {
+		.time_usecs = (uint64_t)state->now.tv_sec * USECS_IN_SEC
+			+ state->now.tv_nsec / NSECS_IN_USEC,
+		.type = action->type == BUTTOND_SHORT_PRESS ? PUBLISH_SHORT
+			: action->type == BUTTOND_LONG_PRESS ? PUBLISH_LONG
+			: PUBLISH_SEQUENCE,
+		.code = key->code,
+		.value = held,
+	};
+
+	/* chord codes change as bindings do, send its keys instead */
+	if (key->code >= KEY_CNT) {
+		for (uint64_t bits = key->chord_mask; bits; bits &= bits - 1) {
+			struct publish_msg member = {
+				.time_usecs = msg.time_usecs,
+				.type = PUBLISH_CHORD_KEY,
+				.code = state->bd.chord_keys[__builtin_ctzll(bits)],
+				.value = __builtin_popcountll(key->chord_mask),
+			};
+
+			publish(state, &member);
+		}
+		msg.code = PUBLISH_CHORD_CODE;
+	}
+	publish(state, &msg);
+}
+
+/* end of loop iteration: send what was queued */
+void publish_flush(struct state *state) {
+	if (!state->publish_pending)
+		return;
+	state->publish_pending = false;
+	if (state->shmring)
+		shmring_wake(state);
+
+	for (int i = 0; i < state->subscriber_count; ) {
+		struct subscriber *sub = state->subscribers[i];
+
+		/* already waiting for POLLOUT */
+		if (sub->source.want_write) {
+			i++;
+			continue;
+		}
+		if (subscriber_send(state, sub) < 0) {
+			/* last one is moved to i */
+			subscriber_close(state, i);
+			continue;
+		}
+		i++;
+	}
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef BUTTOND_PUBLISH_H
+#define BUTTOND_PUBLISH_H
+
+/* Messages sent to buttond --publish <socket> subscribers.
+ * Subscribers connect to the unix stream socket and read a stream of
+ * struct publish_msg, in host byte order. Nothing is read from them:
+ * closing the connection unsubscribes. */
+
+#include <stdint.h>
+
+enum publish_type {
+	/* key event for a configured key, value is the evdev value
+	 * (0 released, 1 pressed, 2 repeat) */
+	PUBLISH_KEY,
+	/* action decided for key, value is how long it was held (ms) */
+	PUBLISH_SHORT,
+	PUBLISH_LONG,
+	/* subscriber did not read fast enough and value messages were
+	 * dropped before this one */
+	PUBLISH_DROPPED,
+	/* action decided for a sequence of taps, value is how long the
+	 * last tap was held (ms) */
+	PUBLISH_SEQUENCE,
+	/* member key of a chord, code is its key code and value the
+	 * number of keys in the chord: one is sent for each of them (in no
+	 * particular order) right before the chord's action, which has
+	 * code PUBLISH_CHORD_CODE. Members are only complete if that many
+	 * were received since the last other message */
+	PUBLISH_CHORD_KEY,
+};
+
+/* code of chord actions, their keys are sent before */
+#define PUBLISH_CHORD_CODE 0xffff
+
+struct publish_msg {
+	/* CLOCK_MONOTONIC, event timestamp for PUBLISH_KEY */
+	uint64_t time_usecs;
+	uint16_t type;
+	uint16_t code;
+	int32_t value;
+};
+
+_Static_assert(sizeof(struct publish_msg) == 16,
+	       "publish_msg should not have padding");
+
+#endif
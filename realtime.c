@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+
+/* --realtime: keep key handling fast when the system is not.
+ *
+ * Arrays that normally grow on demand get room up front, malloc is told
+ * to keep what it has, then all memory is locked and the stack
+ * prefaulted: the main loop does not page fault under memory pressure.
+ * Optionally buttond also runs SCHED_FIFO (--realtime-priority) and on
+ * given cpus (--cpu-affinity). Actions get normal scheduling back:
+ * SCHED_RESET_ON_FORK for the policy, and the original cpu mask is
+ * restored around posix_spawn as there is no spawn attribute for it.
+ */
+
+/* sched_setaffinity and cpu sets, meson already sets it */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <malloc.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "buttond.h"
+
+/* room given up front */
+#define REALTIME_CHILDREN 64
+#define REALTIME_CLIENTS 16
+/* kept in the heap for later allocations, e.g. action environments */
+#define REALTIME_HEAP (1024 * 1024)
+#define REALTIME_STACK (256 * 1024)
+
+struct realtime {
+	/* --cpu-affinity, and mask to restore for actions */
+	bool pinned;
+	cpu_set_t cpus;
+	cpu_set_t cpus_orig;
+};
+
+/* "0,2-3" */
+static void parse_cpus(const char *list, cpu_set_t *cpus) {
+	const char *c = list;
+
+	CPU_ZERO(cpus);
+	while (*c) {
+		char *end;
+		unsigned long first, last;
+
+		first = last = strtoul(c, &end, 10);
+		if (end != c && *end == '-') {
+			c = end + 1;
+			last = strtoul(c, &end, 10);
+		}
+		xassert(end != c && (*end == ',' || !*end)
+			&& first <= last && last < CPU_SETSIZE,
+			"Invalid cpu list %s", list);
+		for (; first <= last; first++)
+			CPU_SET(first, cpus);
+		c = *end ? end + 1 : end;
+	}
+	xassert(CPU_COUNT(cpus) > 0, "Invalid cpu list %s", list);
+}
+
+/* grow array to at least count elements, keeping its content */
+#define RESERVE(array, alloc, count) do { \
+	if ((alloc) < (count)) { \
+		(alloc) = (count); \
+		(array) = xreallocarray((array), (alloc), sizeof(*(array))); \
+	} \
+} while (0)
+
+__attribute__((noinline))
+static void prefault_stack(void) {
+	volatile unsigned char stack[REALTIME_STACK];
+
+	for (size_t i = 0; i < sizeof(stack); i += 4096)
+		stack[i] = 0;
+}
+
+void realtime_init(struct state *state) {
+	struct realtime *rt;
+
+	if (!state->realtime)
+		return;
+
+	rt = xcalloc(1, sizeof(*rt));
+	RESERVE(state->children, state->child_alloc, REALTIME_CHILDREN);
+	if (state->publish_path)
+		RESERVE(state->subscribers, state->subscriber_alloc,
+			REALTIME_CLIENTS);
+	if (state->control_path)
+		RESERVE(state->control_clients, state->control_client_alloc,
+			REALTIME_CLIENTS);
+
+	/* no new mappings or heap shrinking: freed memory stays locked
+	 * for the next allocations */
+	mallopt(M_MMAP_MAX, 0);
+	mallopt(M_TRIM_THRESHOLD, -1);
+	free(xcalloc(1, REALTIME_HEAP));
+	xassert(mlockall(MCL_CURRENT | MCL_FUTURE) == 0,
+		"Could not lock memory: %m");
+	prefault_stack();
+
+	if (state->realtime_cpus) {
+		parse_cpus(state->realtime_cpus, &rt->cpus);
+		xassert(sched_getaffinity(0, sizeof(rt->cpus_orig),
+					  &rt->cpus_orig) == 0,
+			"Could not get cpu affinity: %m");
+		xassert(sched_setaffinity(0, sizeof(rt->cpus), &rt->cpus) == 0,
+			"Could not set cpu affinity %s: %m",
+			state->realtime_cpus);
+		rt->pinned = true;
+	}
+	if (state->realtime_priority) {
+		int min = sched_get_priority_min(SCHED_FIFO);
+		int max = sched_get_priority_max(SCHED_FIFO);
+		struct sched_param param = {
+			.sched_priority = state->realtime_priority,
+		};
+
+		xassert(param.sched_priority >= min
+			&& param.sched_priority <= max,
+			"Realtime priority must be between %d and %d", min, max);
+		xassert(sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK,
+					   &param) == 0,
+			"Could not set SCHED_FIFO priority %d: %m",
+			state->realtime_priority);
+	}
+	state->rt = rt;
+	if (debug)
+		log_printf("realtime: memory locked, %s scheduling, cpus %s\n",
+			   state->realtime_priority ? "SCHED_FIFO" : "normal",
+			   state->realtime_cpus ? state->realtime_cpus : "all");
+}
+
+void realtime_spawn_begin(struct state *state) {
+	struct realtime *rt = state->rt;
+
+	if (rt && rt->pinned)
+		sched_setaffinity(0, sizeof(rt->cpus_orig), &rt->cpus_orig);
+}
+
+void realtime_spawn_end(struct state *state) {
+	struct realtime *rt = state->rt;
+
+	if (rt && rt->pinned)
+		sched_setaffinity(0, sizeof(rt->cpus), &rt->cpus);
+}
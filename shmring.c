@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+
+/* --shm-ring: messages also written to a shared file, see shmring.h.
+ *
+ * Each slot is a small seqlock: seq is cleared, message written, then
+ * seq set to the message number. Readers that want to sleep increment
+ * waiters: they are only woken up once per loop iteration, from
+ * publish_flush, and not at all if nobody waits.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "buttond.h"
+#include "shmring.h"
+
+void shmring_init(struct state *state) {
+	struct shmring_header *ring;
+	size_t size = sizeof(*ring)
+		+ SHMRING_SLOTS * sizeof(ring->slots[0]);
+	char *tmp;
+	int fd;
+
+	if (!state->shmring_path)
+		return;
+
+	/* set up a new file and rename it over path: readers never see
+	 * it half initialized, and readers of a previous run keep their
+	 * mapping of the old one instead of seeing it shrink */
+	tmp = xcalloc(1, strlen(state->shmring_path) + 5);
+	sprintf(tmp, "%s.tmp", state->shmring_path);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	xassert(fd >= 0, "Could not create %s: %m", tmp);
+	xassert(ftruncate(fd, size) == 0, "Could not resize %s: %m", tmp);
+	ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	xassert(ring != MAP_FAILED, "Could not map %s: %m", tmp);
+	close(fd);
+
+	ring->magic = SHMRING_MAGIC;
+	ring->version = SHMRING_VERSION;
+	ring->slot_count = SHMRING_SLOTS;
+	ring->slot_size = sizeof(ring->slots[0]);
+	xassert(rename(tmp, state->shmring_path) == 0,
+		"Could not rename %s to %s: %m", tmp, state->shmring_path);
+	free(tmp);
+	state->shmring = ring;
+}
+
+void shmring_push(struct state *state, struct publish_msg *msg) {
+	struct shmring_header *ring = state->shmring;
+	/* we are the only writer */
+	uint64_t seq = ring->write_seq;
+	struct shmring_slot *slot = &ring->slots[seq & (SHMRING_SLOTS - 1)];
+	uint64_t data[2];
+
+	memcpy(data, msg, sizeof(data));
+	__atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&slot->data[0], data[0], __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->data[1], data[1], __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->write_seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+void shmring_wake(struct state *state) {
+	struct shmring_header *ring = state->shmring;
+
+	/* pairs with shmring_wait: either it sees write_seq, or we see
+	 * it waiting */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&ring->waiters, __ATOMIC_RELAXED))
+		return;
+	__atomic_add_fetch(&ring->futex, 1, __ATOMIC_SEQ_CST);
+	syscall(SYS_futex, &ring->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef BUTTOND_SHMRING_H
+#define BUTTOND_SHMRING_H
+
+/* Layout of buttond --shm-ring file.
+ * Same messages as --publish (see publish.h), written in place in a
+ * ring of slots that any number of readers can map to follow without
+ * making any syscall while messages keep coming.
+ *
+ * buttond is the only writer and never waits for readers: a reader
+ * that falls more than slot_count messages behind has messages
+ * overwritten, which it notices through slot sequence numbers.
+ * Readers that want to sleep register in waiters and wait on futex,
+ * which requires mapping the file writable. buttond creates a new
+ * file when it starts, readers should reopen it if it was replaced.
+ *
+ * Readers only need shmring_read() and shmring_wait() below. */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "publish.h"
+
+#define SHMRING_MAGIC 0x52534442 /* "BDSR" */
+#define SHMRING_VERSION 1
+/* must be a power of two */
+#define SHMRING_SLOTS 4096
+
+struct shmring_slot {
+	/* message number + 1, 0 while being written */
+	uint64_t seq;
+	/* struct publish_msg, as words so it can be copied atomically */
+	uint64_t data[2];
+};
+
+_Static_assert(sizeof(struct publish_msg) == sizeof(((struct shmring_slot *)0)->data),
+	       "publish_msg does not fit in slot");
+
+struct shmring_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;
+	/* sizeof(struct shmring_slot) */
+	uint32_t slot_size;
+	/* messages written so far, message n is in slot n % slot_count */
+	uint64_t write_seq;
+	/* incremented when waking readers up */
+	uint32_t futex;
+	/* readers currently waiting on futex */
+	uint32_t waiters;
+
+	/* followed by slot_count slots */
+	struct shmring_slot slots[];
+};
+
+/* read message *pos into msg:
+ * - 0 if it was read, *pos is incremented
+ * - EAGAIN if it has not been written yet
+ * - EOVERFLOW if it has already been overwritten, *pos is moved to the
+ *   oldest message that was still in the ring: the difference is the
+ *   number of messages lost */
+static inline int shmring_read(struct shmring_header *ring, uint64_t *pos,
+			       struct publish_msg *msg) {
+	struct shmring_slot *slot = &ring->slots[*pos & (ring->slot_count - 1)];
+	uint64_t seq, write_seq, data[2];
+
+	seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	if (seq == *pos + 1) {
+		data[0] = __atomic_load_n(&slot->data[0], __ATOMIC_RELAXED);
+		data[1] = __atomic_load_n(&slot->data[1], __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+			memcpy(msg, data, sizeof(*msg));
+			(*pos)++;
+			return 0;
+		}
+	}
+	write_seq = __atomic_load_n(&ring->write_seq, __ATOMIC_ACQUIRE);
+	if (seq <= *pos && write_seq < *pos + ring->slot_count)
+		return EAGAIN;
+	/* overwritten: skip to oldest, with some margin so we are not
+	 * immediately overwritten again */
+	*pos = write_seq - ring->slot_count + ring->slot_count / 8;
+	return EOVERFLOW;
+}
+
+/* wait until message pos is written, or for timeout if not NULL.
+ * Returns 0 or ETIMEDOUT */
+static inline int shmring_wait(struct shmring_header *ring, uint64_t pos,
+			       const struct timespec *timeout) {
+	uint32_t futex;
+	int rc = 0;
+
+	__atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+	futex = __atomic_load_n(&ring->futex, __ATOMIC_SEQ_CST);
+	/* buttond bumps futex after updating write_seq if it saw us */
+	if (__atomic_load_n(&ring->write_seq, __ATOMIC_SEQ_CST) <= pos
+	    && syscall(SYS_futex, &ring->futex, FUTEX_WAIT, futex,
+		       timeout, NULL, 0) < 0
+	    && errno == ETIMEDOUT)
+		rc = ETIMEDOUT;
+	__atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+	return rc;
+}
+
+#endif
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: MIT
+
+/* Example reader for buttond --shm-ring <file>: print messages as they
+ * come, or count them to measure throughput. Also used by tests.sh to
+ * read a ring after the fact with --all.
+ *
+ * Messages are read in place without any syscall while there are
+ * some, and the reader sleeps on the ring's futex otherwise.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmring.h"
+#include "time_utils.h"
+
+static const char *type_names[] = {
+	[PUBLISH_KEY] = "key",
+	[PUBLISH_SHORT] = "short",
+	[PUBLISH_LONG] = "long",
+	[PUBLISH_DROPPED] = "dropped",
+	[PUBLISH_SEQUENCE] = "sequence",
+	[PUBLISH_CHORD_KEY] = "chord-key",
+};
+
+static struct option long_options[] = {
+	{"all",		no_argument,		0, 'a' },
+	{"count",	required_argument,	0, 'c' },
+	{"quiet",	no_argument,		0, 'q' },
+	{"help",	no_argument,		0, 'h' },
+	{0,		0,			0,  0  }
+};
+
+struct reader {
+	const char *path;
+	struct shmring_header *ring;
+	size_t size;
+	/* inode of path when mapped, to notice buttond restarts */
+	ino_t ino;
+	uint64_t pos;
+	/* start from the oldest message instead of new ones */
+	bool all;
+};
+
+static void help(char *argv0) {
+	printf("Usage: %s [options] <file>\n", argv0);
+	printf("Options:\n");
+	printf("  -a, --all: also read messages already in the ring\n");
+	printf("  -c, --count <n>: exit after n messages and print throughput\n");
+	printf("  -q, --quiet: do not print messages\n");
+}
+
+static void reader_open(struct reader *reader) {
+	struct stat sb;
+	int fd;
+
+	if (reader->ring)
+		munmap(reader->ring, reader->size);
+	reader->ring = NULL;
+
+	/* writable to register as waiter */
+	fd = open(reader->path, O_RDWR | O_CLOEXEC);
+	xassert(fd >= 0, "Could not open %s: %m", reader->path);
+	xassert(fstat(fd, &sb) == 0, "Could not stat %s: %m", reader->path);
+	xassert((size_t)sb.st_size >= sizeof(*reader->ring),
+		"%s is too small for a ring", reader->path);
+	reader->ring = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+	xassert(reader->ring != MAP_FAILED, "Could not map %s: %m",
+		reader->path);
+	close(fd);
+	reader->size = sb.st_size;
+	reader->ino = sb.st_ino;
+
+	struct shmring_header *ring = reader->ring;
+	xassert(ring->magic == SHMRING_MAGIC
+		&& ring->version == SHMRING_VERSION,
+		"%s is not a buttond ring we can read", reader->path);
+	xassert(ring->slot_size == sizeof(ring->slots[0])
+		&& ring->slot_count
+		&& !(ring->slot_count & (ring->slot_count - 1))
+		&& sizeof(*ring) + ring->slot_count * sizeof(ring->slots[0])
+			<= reader->size,
+		"%s has unexpected size", reader->path);
+	/* only new messages, unless --all: reading from the first one
+	 * then skips (and counts as lost) those already overwritten */
+	reader->pos = reader->all ? 0
+		: __atomic_load_n(&ring->write_seq, __ATOMIC_ACQUIRE);
+}
+
+/* not time_gettime: we are not buttond and have no virtual clock */
+static void gettime(struct timespec *ts) {
+	xassert(clock_gettime(CLOCK_MONOTONIC, ts) == 0,
+		"Could not get time: %m");
+}
+
+/* buttond restarted with a new file */
+static bool reader_replaced(struct reader *reader) {
+	struct stat sb;
+
+	return stat(reader->path, &sb) == 0 && sb.st_ino != reader->ino;
+}
+
+int main(int argc, char *argv[]) {
+	struct reader reader = { 0 };
+	struct timespec start, end, timeout = { .tv_sec = 1 };
+	struct publish_msg msg;
+	uint64_t count = 0, received = 0, lost = 0;
+	bool quiet = false;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "ac:qh", long_options, NULL)) >= 0) {
+		switch (c) {
+		case 'a':
+			reader.all = true;
+			break;
+		case 'c':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 'q':
+			quiet = true;
+			break;
+		case 'h':
+			help(argv[0]);
+			exit(EXIT_SUCCESS);
+		default:
+			help(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (optind != argc - 1) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	reader.path = argv[optind];
+	reader_open(&reader);
+
+	while (!count || received + lost < count) {
+		uint64_t pos = reader.pos;
+
+		switch (shmring_read(reader.ring, &reader.pos, &msg)) {
+		case 0:
+			/* start timing at first message */
+			if (!received++)
+				gettime(&start);
+			if (quiet)
+				break;
+			printf("%"PRIu64".%06"PRIu64" %s %d %d\n",
+			       msg.time_usecs / USECS_IN_SEC,
+			       msg.time_usecs % USECS_IN_SEC,
+			       msg.type < sizeof(type_names) / sizeof(type_names[0])
+					? type_names[msg.type] : "unknown",
+			       msg.code, msg.value);
+			break;
+		case EOVERFLOW:
+			lost += reader.pos - pos;
+			if (!quiet)
+				printf("lost %"PRIu64" messages\n",
+				       reader.pos - pos);
+			break;
+		case EAGAIN:
+			if (!quiet)
+				fflush(stdout);
+			if (shmring_wait(reader.ring, reader.pos, &timeout)
+					== ETIMEDOUT
+			    && reader_replaced(&reader)) {
+				if (!quiet)
+					printf("%s was replaced, reopening\n",
+					       reader.path);
+				reader_open(&reader);
+			}
+			break;
+		}
+	}
+
+	if (count) {
+		gettime(&end);
+		double secs = time_diff_ns(&end, &start) / (double)NSECS_IN_SEC;
+
+		printf("%"PRIu64" messages read in %.3fs: %.0f messages/s, %"PRIu64" lost\n",
+		       received, secs, secs > 0 ? received / secs : 0, lost);
+	}
+	return 0;
+}
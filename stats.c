@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: MIT
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "buttond.h"
+
+static const char *latency_names[BUTTOND_LATENCY_COUNT] = {
+	[BUTTOND_LATENCY_READ] = "event to read",
+	[BUTTOND_LATENCY_DECISION] = "read to decision",
+	[BUTTOND_LATENCY_EXEC] = "decision to exec",
+};
+
+static const char *state_names[BUTTOND_STATS_KEY_STATES] = {
+	[BUTTOND_KEY_RELEASED] = "released",
+	[BUTTOND_KEY_PRESSED] = "pressed",
+	[BUTTOND_KEY_DEBOUNCE] = "debounce",
+	[BUTTOND_KEY_HANDLED] = "handled",
+	[BUTTOND_KEY_TAPPED] = "tapped",
+};
+
+/* create zeroed stats for bd's keys, carrying over counters from old
+ * (of state->bd's keys) if set.
+ * The file is set up under a temporary name and renamed over the
+ * previous one: readers mapping that one (--dump-stats) keep it, it
+ * is never truncated under them */
+static void stats_map(struct state *state, struct buttond *bd,
+		      struct buttond_stats_header *old) {
+	struct buttond_stats_header *stats;
+	size_t size = sizeof(*stats) + bd->key_count * sizeof(stats->keys[0]);
+	char *tmp = NULL;
+
+	if (state->stats_file) {
+		int fd;
+
+		tmp = xcalloc(1, strlen(state->stats_file) + 5);
+		sprintf(tmp, "%s.tmp", state->stats_file);
+		fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		xassert(fd >= 0, "Could not create %s: %m", tmp);
+		xassert(ftruncate(fd, size) == 0,
+			"Could not resize %s: %m", tmp);
+		stats = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			     fd, 0);
+		xassert(stats != MAP_FAILED, "Could not map %s: %m", tmp);
+		close(fd);
+	} else {
+		stats = xcalloc(1, size);
+	}
+
+	stats->magic = BUTTOND_STATS_MAGIC;
+	stats->version = BUTTOND_STATS_VERSION;
+	stats->key_count = bd->key_count;
+	stats->key_stats_size = sizeof(stats->keys[0]);
+	/* global counters */
+	if (old)
+		memcpy(&stats->events_read, &old->events_read,
+		       sizeof(*stats)
+		       - offsetof(struct buttond_stats_header, events_read));
+	for (int i = 0; i < bd->key_count; i++) {
+		struct buttond_key *key = &bd->keys[i];
+		struct buttond_key *prev = NULL;
+
+		/* keys that stay (chords matched by name, their codes
+		 * change) keep their counters, keys were given stats in
+		 * order */
+		if (old)
+			prev = buttond_same_key(&state->bd, key);
+		else
+			key->ts_state = state->now;
+		if (prev)
+			stats->keys[i] = old->keys[prev - state->bd.keys];
+		key->stats = &stats->keys[i];
+		key->stats->code = key->code;
+	}
+
+	if (tmp) {
+		xassert(rename(tmp, state->stats_file) == 0,
+			"Could not rename %s to %s: %m", tmp, state->stats_file);
+		free(tmp);
+	}
+	state->stats = stats;
+	state->stats_size = size;
+}
+
+void stats_init(struct state *state) {
+	stats_map(state, &state->bd, NULL);
+}
+
+/* keys are about to be replaced by next: counters of keys that stay
+ * are carried over, new keys start from zero */
+void stats_reload(struct state *state, struct buttond *next) {
+	struct buttond_stats_header *old = state->stats;
+	size_t old_size = state->stats_size;
+
+	stats_map(state, next, old);
+	if (state->stats_file)
+		munmap(old, old_size);
+	else
+		free(old);
+}
+
+static void dump_hist(FILE *out, uint32_t *buckets) {
+	for (int b = 0; b < BUTTOND_STATS_BUCKETS; b++) {
+		if (!buckets[b])
+			continue;
+		fprintf(out, " <%"PRIu64": %"PRIu32,
+			(uint64_t)1 << b, buckets[b]);
+	}
+	fprintf(out, "\n");
+}
+
+void stats_dump(struct buttond_stats_header *stats, FILE *out) {
+	fprintf(out, "events read: %"PRIu64"\n", stats->events_read);
+	fprintf(out, "unbound events dropped: %"PRIu64"\n", stats->unbound_dropped);
+	fprintf(out, "reopens: %"PRIu64"\n", stats->reopen_count);
+	fprintf(out, "events lost (SYN_DROPPED): %"PRIu64"\n", stats->syn_dropped);
+	fprintf(out, "inotify events: %"PRIu64"\n", stats->inotify_events);
+	fprintf(out, "subscribers: %"PRIu64", published: %"PRIu64", dropped: %"PRIu64"\n",
+		stats->subscribers, stats->published, stats->publish_dropped);
+	fprintf(out, "log messages dropped: %"PRIu64"\n", stats->log_dropped);
+
+	for (uint32_t i = 0; i < stats->key_count; i++) {
+		struct buttond_key_stats *key = &stats->keys[i];
+
+		fprintf(out, "key %s (%d):\n",
+			!key->code ? "exit timeout"
+			: key->code >= KEY_CNT ? "chord"
+			: buttond_keyname_by_code(key->code),
+			key->code);
+		fprintf(out, "  presses: %"PRIu64", debounce merges: %"PRIu64"\n",
+			key->presses, key->debounce_merges);
+		fprintf(out, "  short actions: %"PRIu64", long actions: %"PRIu64
+			", sequence actions: %"PRIu64
+			", ignored releases: %"PRIu64"\n",
+			key->short_actions, key->long_actions,
+			key->sequence_actions, key->ignored_releases);
+		fprintf(out, "  time in state (ms):");
+		for (int s = 0; s < BUTTOND_STATS_KEY_STATES; s++)
+			fprintf(out, " %s %"PRIu64, state_names[s],
+				key->state_nsecs[s] / NSECS_IN_MSEC);
+		fprintf(out, "\n  press duration (ms):");
+		dump_hist(out, key->press_duration);
+		for (int l = 0; l < BUTTOND_LATENCY_COUNT; l++) {
+			struct buttond_latency_hist *hist = &key->latency[l];
+
+			fprintf(out, "  %s (us, max %"PRIu64"):",
+				latency_names[l], hist->max_usecs);
+			dump_hist(out, hist->buckets);
+		}
+	}
+	fflush(out);
+}
+
+/* print stats file of another buttond */
+int stats_dump_file(const char *path) {
+	struct buttond_stats_header *stats;
+	struct stat sb;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	xassert(fd >= 0, "Could not open %s: %m", path);
+	xassert(fstat(fd, &sb) == 0, "Could not stat %s: %m", path);
+	xassert((size_t)sb.st_size >= sizeof(*stats),
+		"%s is too small for a stats file", path);
+	stats = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	xassert(stats != MAP_FAILED, "Could not map %s: %m", path);
+	close(fd);
+
+	xassert(stats->magic == BUTTOND_STATS_MAGIC
+		&& stats->version == BUTTOND_STATS_VERSION,
+		"%s is not a buttond stats file we can read", path);
+	xassert(stats->key_stats_size == sizeof(stats->keys[0])
+		&& sizeof(*stats) + stats->key_count * sizeof(stats->keys[0])
+			<= (size_t)sb.st_size,
+		"%s has unexpected size", path);
+	stats_dump(stats, stdout);
+	return 0;
+}
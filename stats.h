@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef BUTTOND_STATS_H
+#define BUTTOND_STATS_H
+
+/* Layout of buttond --stats-file.
+ * The file is updated in place while buttond runs, readers should map
+ * it read-only and check magic, version and sizes.
+ * Counters are updated without any locking: values can be slightly
+ * inconsistent with each other, but each field is read atomically on
+ * 64 bit platforms. */
+
+#include <stdint.h>
+
+#define BUTTOND_STATS_MAGIC 0x54534442 /* "BDST" */
+#define BUTTOND_STATS_VERSION 5
+
+/* latencies recorded for each action */
+enum buttond_latency {
+	/* kernel event timestamp to main loop wakeup */
+	BUTTOND_LATENCY_READ,
+	/* from when the decision was due (end of debounce or long press
+	 * timer) to when handle_timeouts made it */
+	BUTTOND_LATENCY_DECISION,
+	/* starting the action */
+	BUTTOND_LATENCY_EXEC,
+	BUTTOND_LATENCY_COUNT,
+};
+
+/* log2 histograms: bucket i counts values in [2^(i-1), 2^i),
+ * bucket 0 counts 0 */
+#define BUTTOND_STATS_BUCKETS 32
+
+struct buttond_latency_hist {
+	/* in us */
+	uint32_t buckets[BUTTOND_STATS_BUCKETS];
+	uint64_t max_usecs;
+};
+
+/* key states, in enum buttond_key_state order:
+ * released, pressed, debounce, handled, tapped */
+#define BUTTOND_STATS_KEY_STATES 5
+
+struct buttond_key_stats {
+	uint16_t code;
+	uint16_t pad[3];
+	/* new key presses, not counting presses merged by debounce */
+	uint64_t presses;
+	uint64_t debounce_merges;
+	uint64_t short_actions;
+	uint64_t long_actions;
+	uint64_t sequence_actions;
+	/* releases that did not match any action */
+	uint64_t ignored_releases;
+	/* in ms, log2 buckets */
+	uint32_t press_duration[BUTTOND_STATS_BUCKETS];
+	/* time spent in each state, updated on state change */
+	uint64_t state_nsecs[BUTTOND_STATS_KEY_STATES];
+	struct buttond_latency_hist latency[BUTTOND_LATENCY_COUNT];
+};
+
+struct buttond_stats_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key_count;
+	/* sizeof(struct buttond_key_stats) */
+	uint32_t key_stats_size;
+
+	/* global counters */
+	uint64_t events_read;
+	uint64_t unbound_dropped;
+	uint64_t reopen_count;
+	uint64_t inotify_events;
+	/* --publish: current subscribers, messages queued and dropped
+	 * for slow subscribers (counted once per subscriber) */
+	uint64_t subscribers;
+	uint64_t published;
+	uint64_t publish_dropped;
+	/* -v messages dropped as the log sink could not keep up */
+	uint64_t log_dropped;
+	/* SYN_DROPPED received: the kernel buffer overflowed */
+	uint64_t syn_dropped;
+
+	/* followed by key_count struct buttond_key_stats */
+	struct buttond_key_stats keys[];
+};
+
+#endif
@@ -18,6 +18,8 @@ done
 BUTTOND="$(realpath "$BUTTOND")"
 [ -f "$GEN_EVENTS" ] && [ -x "$GEN_EVENTS" ] || error "buttond binary not found, please set GEN_EVENTS manually"
 GEN_EVENTS="$(realpath "$GEN_EVENTS")"
+[ -e "$SHMRING_READER" ] || SHMRING_READER="$(dirname "$BUTTOND")/shmring_reader"
+[ -f "$SHMRING_READER" ] && [ -x "$SHMRING_READER" ] || error "shmring_reader binary not found, please set SHMRING_READER manually"
 cd "$TESTDIR" || exit 1
 declare -A PROCESSES=( )
 declare -A CHECKS=( )
@@ -64,6 +66,46 @@ run_pattern() {
 	PROCESSES[$testname]=$!
 }
 
+# like run_pattern, with buttond run a second time once the first is
+# done, e.g. to check what a restart keeps
+run_twice() {
+	local testname="$1"
+	shift
+
+	# skip tests we didn't ask for
+	case ",$ONLY," in
+	",,"|*",$testname,"*) ;;
+	*) return;;
+	esac
+
+	declare -a keys=( )
+	while [[ $# -gt 0 ]]; do
+		if [[ "$1" = "--" ]]; then
+			shift
+			break
+		fi
+		keys+=( "$1" )
+		shift
+	done
+
+	if [[ -n "$DRYRUN" ]]; then
+		for _ in 1 2; do
+			printf '"%s" ' "$BUTTOND" --test_mode
+			printf '<("%s" ' "$GEN_EVENTS"
+			printf '%s ' "${keys[@]}"
+			printf ') '
+			printf '"%s" ' "$@"
+			echo
+		done
+		return
+	fi >&2
+	(
+		"$BUTTOND" --test_mode <("$GEN_EVENTS" "${keys[@]}") "$@" \
+			&& "$BUTTOND" --test_mode <("$GEN_EVENTS" "${keys[@]}") "$@"
+	) &
+	PROCESSES[$testname]=$!
+}
+
 run_inotify() {
 	local testname="$1"
 	local pipe="$testname"
@@ -106,6 +148,238 @@ run_inotify() {
 	PROCESSES[$testname]=$!
 }
 
+# like run_inotify, with a subscriber to --publish socket writing
+# messages it got to file $testname, one per line. The input pipe is
+# only created once it is connected, so it gets every message
+run_publish() {
+	local testname="$1"
+	local pipe="$testname.pipe"
+	shift
+
+	# skip tests we didn't ask for
+	case ",$ONLY," in
+	",,"|*",$testname,"*) ;;
+	*) return;;
+	esac
+
+	declare -a keys=( )
+	while [[ $# -gt 0 ]]; do
+		if [[ "$1" = "--" ]]; then
+			shift
+			break
+		fi
+		keys+=( "$1" )
+		shift
+	done
+
+	if [[ -n "$DRYRUN" ]]; then
+		printf '"%s" ' "$BUTTOND" --test_mode -i "$pipe" \
+			--publish "$testname.sock" "$@"
+		echo '&'
+		return
+	fi >&2
+	(
+		"$BUTTOND" --test_mode -i "$pipe" --publish "$testname.sock" \
+			"$@" 2>/dev/null &
+		BPID=$!
+		python3 - "$testname.sock" "$pipe" "$GEN_EVENTS" "${keys[@]}" \
+			> "$testname" <<'PYEOF' || exit
+import os, socket, struct, subprocess, sys, time
+sock = socket.socket(socket.AF_UNIX)
+for _ in range(50):
+    try:
+        sock.connect(sys.argv[1])
+        break
+    except OSError:
+        time.sleep(0.1)
+else:
+    sys.exit('could not connect')
+os.mkfifo(sys.argv[2])
+with open(sys.argv[2], 'wb') as pipe:
+    gen = subprocess.Popen(sys.argv[3:], stdout=pipe)
+data = b''
+while chunk := sock.recv(4096):
+    data += chunk
+for i in range(0, len(data), 16):
+    _, msgtype, code, value = struct.unpack('QHHi', data[i:i+16])
+    print(msgtype, code, value)
+sys.exit(gen.wait())
+PYEOF
+		wait $BPID
+	) &
+	PROCESSES[$testname]=$!
+}
+
+# --publish subscriber that does not read while $count repeats of key
+# 148 are sent, and until the action of a 149 press ran (created file
+# $testname.ran). It then reads what was queued and presses 149 again:
+# it must get a PUBLISH_DROPPED message, and what it got must match
+# published and dropped counts in stats
+run_publish_stuck() {
+	local testname="$1"
+	local pipe="$testname.pipe"
+	local count="$2"
+	shift 2
+
+	# skip tests we didn't ask for
+	case ",$ONLY," in
+	",,"|*",$testname,"*) ;;
+	*) return;;
+	esac
+
+	if [[ -n "$DRYRUN" ]]; then
+		printf '"%s" ' "$BUTTOND" --test_mode -i "$pipe" \
+			--publish "$testname.sock" \
+			--stats-file "$testname.stats" "$@"
+		echo '&'
+		return
+	fi >&2
+	(
+		"$BUTTOND" --test_mode -i "$pipe" --publish "$testname.sock" \
+			--stats-file "$testname.stats" "$@" 2>/dev/null &
+		BPID=$!
+		python3 - "$testname" "$count" "$BUTTOND" <<'PYEOF' || exit
+import os, socket, struct, subprocess, sys, time
+testname, count, buttond = sys.argv[1], int(sys.argv[2]), sys.argv[3]
+sock = socket.socket(socket.AF_UNIX)
+for _ in range(50):
+    try:
+        sock.connect(testname + '.sock')
+        break
+    except OSError:
+        time.sleep(0.1)
+else:
+    sys.exit('could not connect')
+os.mkfifo(testname + '.pipe')
+pipe = open(testname + '.pipe', 'wb', buffering=0)
+now_ms = 1000
+def key(code, value, delay):
+    global now_ms
+    for ev_type, code, value in ((1, code, value), (0, 0, 0)):
+        pipe.write(struct.pack('LLHHI', now_ms // 1000,
+                               (now_ms % 1000) * 1000, ev_type, code, value))
+    now_ms += delay
+
+key(148, 1, 0)
+for _ in range(count):
+    key(148, 2, 0)
+key(148, 0, 100)
+key(149, 1, 100)
+# an unbound key moves the clock for 149 to be decided
+key(149, 0, 1000)
+key(1, 0, 0)
+for _ in range(100):
+    if os.path.exists(testname + '.ran'):
+        break
+    time.sleep(0.05)
+else:
+    sys.exit(f'{testname}: action did not run')
+
+data = b''
+sock.settimeout(0.5)
+try:
+    while chunk := sock.recv(65536):
+        data += chunk
+except TimeoutError:
+    pass
+sock.settimeout(None)
+key(149, 1, 100)
+key(149, 0, 1000)
+key(1, 0, 0)
+pipe.close()
+while chunk := sock.recv(65536):
+    data += chunk
+
+published = dropped = 0
+for i in range(0, len(data), 16):
+    _, msgtype, code, value = struct.unpack('QHHi', data[i:i+16])
+    if msgtype == 3:
+        dropped += value
+    else:
+        published += 1
+if not dropped:
+    sys.exit(f'{testname}: got no PUBLISH_DROPPED')
+stats = subprocess.run([buttond, '--dump-stats', testname + '.stats'],
+                       capture_output=True, text=True, check=True).stdout
+expected = f'published: {published}, dropped: {dropped}'
+if expected not in stats:
+    sys.exit(f'{testname}: expected {expected} in stats:\n{stats}')
+PYEOF
+		wait $BPID
+	) &
+	PROCESSES[$testname]=$!
+}
+
+# like run_inotify, with steps that are either events as for
+# gen_events.py, or commands sent to --control socket prefixed with
+# the expected reply (e.g. "ok:add -s 148 -a true"). Commands are only
+# sent once previous events have been written.
+run_control() {
+	local testname="$1"
+	local pipe="$testname.pipe"
+	shift
+
+	# skip tests we didn't ask for
+	case ",$ONLY," in
+	",,"|*",$testname,"*) ;;
+	*) return;;
+	esac
+
+	declare -a steps=( )
+	while [[ $# -gt 0 ]]; do
+		if [[ "$1" = "--" ]]; then
+			shift
+			break
+		fi
+		steps+=( "$1" )
+		shift
+	done
+
+	if [[ -n "$DRYRUN" ]]; then
+		printf '"%s" ' "$BUTTOND" --test_mode -i "$pipe" \
+			--control "$testname.sock" "$@"
+		echo '&'
+		return
+	fi >&2
+	(
+		"$BUTTOND" --test_mode -i "$pipe" --control "$testname.sock" \
+			"$@" 2>/dev/null &
+		BPID=$!
+		sleep 1
+		mkfifo "$pipe"
+		python3 - "$testname.sock" "$pipe" "${steps[@]}" <<'PYEOF' || exit
+import os, socket, struct, sys
+sock = socket.socket(socket.AF_UNIX)
+sock.connect(sys.argv[1])
+# only for our user, whatever the umask
+if os.stat(sys.argv[1]).st_mode & 0o777 != 0o600:
+    sys.exit(f'{sys.argv[1]}: mode {os.stat(sys.argv[1]).st_mode:o}')
+replies = sock.makefile('r')
+pipe = open(sys.argv[2], 'wb', buffering=0)
+now_ms = 1000
+def event(ev_type, key, value):
+    pipe.write(struct.pack('LLHHI', now_ms // 1000, (now_ms % 1000) * 1000,
+                           ev_type, key, value))
+for step in sys.argv[3:]:
+    if ':' in step:
+        expected, command = step.split(':', 1)
+        sock.sendall(command.encode() + b'\n')
+        reply = replies.readline()
+        if not reply.startswith(expected):
+            sys.exit(f'{command}: got {reply}')
+        continue
+    key, value, delay = step.split(',')
+    event(1, int(key), int(value))
+    event(0, 0, 0)
+    now_ms += int(delay)
+now_ms += 1000
+event(0, 0, 0)
+PYEOF
+		wait $BPID
+	) &
+	PROCESSES[$testname]=$!
+}
+
 check_fail() {
 	local testname="$1"
 	shift
@@ -149,6 +423,16 @@ fail() {
 	FAIL=$((FAIL+1))
 }
 
+# all lines of $1.expected must be lines of $2
+check_lines() {
+	local line
+
+	[[ -e "$2" ]] || { fail "$2 does not exist"; return; }
+	while IFS= read -r line; do
+		grep -qxF -- "$line" "$2" || fail "$2: missing line '$line'"
+	done < "$1.expected"
+}
+
 check_all() {
 	local file check testname tmp
 
@@ -168,6 +452,24 @@ check_all() {
 		e)
 			[[ -e "$file" ]] || fail "$file does not exist"
 			;;
+		m)
+			check_lines "$file" "$file"
+			;;
+		s)
+			"$BUTTOND" --dump-stats "$file" > "$file.txt" \
+				|| fail "could not dump $file"
+			check_lines "$file" "$file.txt"
+			;;
+		c)
+			diff -u "$file.expected" "$file" >&2 \
+				|| fail "$file differs from $file.expected"
+			;;
+		d)
+			"$BUTTOND" --decode-log "$file" > "$file.txt" \
+				|| fail "could not decode $file"
+			diff -u "$file.expected" "$file.txt" >&2 \
+				|| fail "$file.txt differs from $file.expected"
+			;;
 		l*)
 			check="${check#l}"
 			tmp="$(wc -l "$file")"
@@ -183,6 +485,198 @@ run_pattern shortkey 148,1,100 148,0,0 -- \
 	-s PROG1 -a "touch shortkey"
 add_check shortkey e-shortkey
 
+run_pattern exec_direct 148,1,100 148,0,0 -- \
+	-s PROG1 -x "touch 'exec direct'"
+add_check exec_direct "e-exec direct"
+
+run_pattern exec_env 148,1,100 148,0,0 -- \
+	-s PROG1 -a 'touch "exec_env_${BUTTOND_KEY}_${BUTTOND_CODE}_${BUTTOND_DURATION}"'
+add_check exec_env e-exec_env_PROG1_148_100
+
+run_pattern stats_file 148,1,100 148,0,100 148,1,100 148,0,5 148,1,1500 148,0,0 -- \
+	-s PROG1 -a "true" --stats-file stats_file
+cat > stats_file.expected <<'EOF'
+events read: 13
+key PROG1 (148):
+  presses: 2, debounce merges: 1
+  short actions: 1, long actions: 0, sequence actions: 0, ignored releases: 1
+EOF
+add_check stats_file s-stats_file
+
+# -v output through the log ring, as text and binary
+run_pattern log_file 148,1,100 148,0,0 -- \
+	-s PROG1 -a "true" -v --log-file log_file
+add_check log_file l3-log_file
+run_pattern log_binary 148,1,100 148,0,0 -- \
+	-s PROG1 -a "true" -v --log-file log_binary --log-binary
+add_check log_binary e-log_binary
+# a restart appends to the binary log, with its own header
+run_twice log_binary_restart 148,1,100 148,0,0 -- \
+	-s PROG1 -a "true" -v --log-file log_binary_restart --log-binary
+cat > log_binary_restart.expected <<'EOF'
+[1.000] PROG1 (148) pressed: processing
+[1.100] PROG1 (148) released: processing
+running true after 100 ms
+[1.000] PROG1 (148) pressed: processing
+[1.100] PROG1 (148) released: processing
+running true after 100 ms
+EOF
+add_check log_binary_restart d-log_binary_restart
+
+# bindings from a config file and its drop-in directory, where only
+# *.conf files are read
+mkdir -p config_file.d
+cat > config_file.conf <<'EOF'
+# comment
+debounce-time: 0
+short prog1 400: echo short >> config_file
+long prog1 500 exec: sh -c 'echo long >> config_file'
+sequence 150 ss 200: echo double >> config_file
+include: config_file.d
+include: config_file.missing
+EOF
+echo "short 149: echo dropin >> config_file" > config_file.d/10-dropin.conf
+echo "short 149: echo ignored >> config_file" > config_file.d/10-dropin.conf.bak
+run_pattern config_file 148,1,100 148,0,0 148,1,600 148,0,0 149,1,100 149,0,0 \
+		150,1,100 150,0,100 150,1,100 150,0,0 -- \
+	-c config_file.conf
+add_check config_file l4-config_file
+
+# includes that are not missing but cannot be read are errors
+echo "include: config_file.conf/sub" > config_include_notdir.conf
+check_fail config_include_notdir /dev/null -c config_include_notdir.conf
+
+# bindings written as C for buttond-builtin, checked when generated
+run_pattern emit_c -- \
+	--emit-c emit_c.c -s 148 -t 400 -a "echo short" -l 148 -t 500 -x "echo long"
+add_check emit_c e-emit_c.c
+check_fail emit_c_invalid --emit-c emit_c_invalid.c \
+	-s 148 -t 2000 -a "echo 1" -l 148 -t 1000 -a "echo 1"
+
+# all codes of the key table before it was hashed (numeric KEY_ defines
+# below KEY_MAX, last name wins) still resolve, KEY_BRIGHTNESS_MAX too
+declare -A keynames=( )
+while read -r _ name code _; do
+	code=$((code))
+	(( code > 0 && code < 0x2ff )) && keynames[$code]=${name#KEY_}
+done < <(grep -E '^#define KEY_\w+\s+(0x[0-9a-fA-F]+|[0-9]+)\b' \
+		/usr/include/linux/input-event-codes.h)
+declare -a keynames_args=( )
+echo "static struct buttond_key keys[${#keynames[@]}] = {" > emit_c_keynames.c.expected
+for code in "${!keynames[@]}"; do
+	keynames_args+=( -s "${keynames[$code]}" -a true )
+	echo "static const struct buttond_action actions_$code[] = {"
+done >> emit_c_keynames.c.expected
+run_pattern emit_c_keynames -- --emit-c emit_c_keynames.c "${keynames_args[@]}"
+add_check emit_c_keynames m-emit_c_keynames.c
+
+# kernel buffer overflow: events between SYN_DROPPED and SYN_REPORT
+# are ignored, then keys are resynced without running actions for
+# presses whose release was lost
+run_pattern syn_dropped_release 148,1,100 0,3,0,0 \
+	$(for _ in {1..500}; do echo 1,148,1,0 1,148,0,0; done) 0,0,0,3000 -- \
+	-s 148 -a "touch syn_dropped_release_short" \
+	-l 148 -t 2000 -a "touch syn_dropped_release_long"
+add_check syn_dropped_release ne-syn_dropped_release_short ne-syn_dropped_release_long
+
+run_pattern syn_dropped_press 0,3,0,0 1,148,1,0 0,0,0,2500 -- \
+	-l 148 -t 2000 -a "touch syn_dropped_press"
+add_check syn_dropped_press e-syn_dropped_press
+
+# keys changing in the same SYN_REPORT frame are handled together
+run_pattern frame 1,148,1,0 1,149,1,0 0,0,0,100 1,148,0,0 1,149,0,0 0,0,0,0 -- \
+	-s 148 -a "echo 148 >> frame" -s 149 -a "echo 149 >> frame"
+add_check frame l2-frame
+
+# chords: individual actions of their keys are not run once they are
+# all down, whether pressed in the same frame or one after the other
+run_pattern chord_long 1,115,1,0 1,116,1,0 0,0,0,3200 115,0,0 116,0,0 -- \
+	-l VOLUMEUP+POWER -t 3000 -a "echo chord >> chord_long" \
+	-s VOLUMEUP -a "echo volumeup >> chord_long" \
+	-l POWER -t 2000 -a "echo power >> chord_long"
+add_check chord_long l1-chord_long
+
+run_pattern chord_short 115,1,100 116,1,200 116,0,0 115,0,0 -- \
+	-s 116+115 -a "echo chord >> chord_short" \
+	-s 115 -a "echo volumeup >> chord_short" \
+	-s 116 -a "echo power >> chord_short"
+add_check chord_short l1-chord_short
+
+run_pattern chord_alone 115,1,100 115,0,100 116,1,100 116,0,0 -- \
+	-s VOLUMEUP+POWER -a "echo chord >> chord_alone" \
+	-s VOLUMEUP -a "echo volumeup >> chord_alone" \
+	-s POWER -a "echo power >> chord_alone"
+add_check chord_alone l2-chord_alone
+
+# a larger chord takes over chords made of some of its keys
+run_pattern chord_subset 114,1,100 115,1,100 116,1,100 116,0,0 115,0,0 114,0,0 -- \
+	-s 114+115 -a "touch chord_subset_small" \
+	-s 114+115+116 -a "touch chord_subset_large"
+add_check chord_subset ne-chord_subset_small e-chord_subset_large
+
+check_fail chord_single /dev/null -s 115+115 -a true
+
+# a single press waits for sequences that could follow
+run_pattern tap_double 115,1,100 115,0,100 115,1,100 115,0,0 -- \
+	-S 115:ss -a "touch tap_double" \
+	-s 115 -a "touch tap_double_single"
+add_check tap_double e-tap_double ne-tap_double_single
+
+run_pattern tap_single 115,1,100 115,0,0 -- \
+	-S 115:ss -a "touch tap_single" \
+	-s 115 -a "touch tap_single_short"
+add_check tap_single ne-tap_single e-tap_single_short
+
+run_pattern tap_slow 115,1,100 115,0,500 115,1,100 115,0,0 -- \
+	-S 115:ss -a "touch tap_slow" \
+	-s 115 -a "echo single >> tap_slow_single"
+add_check tap_slow ne-tap_slow l2-tap_slow_single
+
+# longest sequence wins, long taps are held as long as short presses
+run_pattern tap_sequence 115,1,100 115,0,100 115,1,100 115,0,100 \
+		115,1,1500 115,0,0 -- \
+	-S VOLUMEUP:ss -a "touch tap_sequence_ss" \
+	-S VOLUMEUP:ssl -t 200 -a "echo ssl >> tap_sequence"
+add_check tap_sequence ne-tap_sequence_ss l1-tap_sequence
+
+check_fail tap_invalid /dev/null -S 115:sx -a true
+
+# commands take longer than presses: at most one at a time
+run_pattern busy_drop 148,1,100 148,0,100 148,1,100 148,0,100 148,1,100 148,0,0 -- \
+	-s 148 --max-running 1 -a "sleep 1; echo run >> busy_drop"
+add_check busy_drop l1-busy_drop
+
+run_pattern busy_queue 148,1,100 148,0,100 148,1,100 148,0,100 148,1,100 148,0,0 -- \
+	-s 148 --when-busy queue --queue-depth 1 \
+	-a "sleep 0.5; echo run >> busy_queue"
+add_check busy_queue l2-busy_queue
+
+# the last trigger is the one queued
+run_pattern busy_coalesce 148,1,100 148,0,100 148,1,200 148,0,100 148,1,300 148,0,0 -- \
+	-s 148 --when-busy coalesce \
+	-a 'sleep 0.5; touch busy_coalesce_$BUTTOND_DURATION'
+add_check busy_coalesce e-busy_coalesce_100 ne-busy_coalesce_200 e-busy_coalesce_300
+
+run_pattern busy_replace 148,1,100 148,0,100 148,1,100 148,0,100 148,1,100 148,0,0 -- \
+	-s 148 --when-busy replace -a "sleep 1; echo run >> busy_replace"
+add_check busy_replace l1-busy_replace
+
+run_pattern time_limit 148,1,100 148,0,0 -- \
+	-s 148 --time-limit 500 -a "sleep 2; touch time_limit"
+add_check time_limit ne-time_limit
+
+# same on the real clock, where limits are not all reached by the last
+# event: 148 finishes in time, 149 is stopped with the sh it started,
+# and 150 keeps buttond running past when that one would touch its file
+run_pattern time_limit_realtime 148,1,100 148,0,0 149,1,100 149,0,0 150,1,100 150,0,0 -- \
+	--test_mode=realtime \
+	-s 148 --time-limit 3000 -a "sleep 0.2; touch time_limit_realtime" \
+	-s 149 --time-limit 300 \
+	-a "sh -c 'sleep 1; touch time_limit_grandchild' & sleep 1; touch time_limit_killed" \
+	-s 150 -a "sleep 2"
+add_check time_limit_realtime e-time_limit_realtime ne-time_limit_killed \
+	ne-time_limit_grandchild
+
 run_pattern shortkey_norun 148,1,1100 148,0,0 -- \
 	-s prog1 -a "touch shortkey_norun"
 add_check shortkey_norun ne-shortkey_norun
@@ -289,6 +783,11 @@ run_pattern multiinput 148,1,100 148,0,0 -- \
 	-s 149 -a "touch multiinput_2"
 add_check multiinput e-multiinput_1 e-multiinput_2
 
+run_pattern async_action 148,1,10 148,0,100 149,1,10 149,0,0 -- \
+	-s 148 -a "sleep 1; touch async_action_slow" \
+	-s 149 -a "[ -e async_action_slow ] || touch async_action_fast"
+add_check async_action e-async_action_fast e-async_action_slow
+
 run_inotify inotify 148,1,100 148,0,0 -- \
 	-s 148 -a "touch inotify_ok"
 add_check inotify e-inotify_ok
@@ -301,6 +800,112 @@ run_inotify subdir/mkdir 148,1,100 fdsf 148,0,0  -- \
 	-s 148 -a "touch inotify_mkdir"
 add_check subdir/mkdir e-inotify_mkdir
 
+# key events, and short and long decisions once they are made
+run_publish publish 148,1,100 148,0,0 149,1,700 149,0,0 -- \
+	-s 148 -a "true" -l 149 -t 500 -a "true"
+cat > publish.expected <<'EOF'
+0 148 1
+0 148 0
+0 149 1
+1 148 100
+2 149 500
+0 149 0
+EOF
+add_check publish c-publish
+
+# chord actions come after their keys, not with their code (which
+# depends on the order chords were added in)
+run_publish publish_chord 115,1,100 116,1,200 116,0,0 115,0,0 -- \
+	-s MUTE+VOLUMEDOWN -a "true" -s VOLUMEUP+POWER -a "true"
+cat > publish_chord.expected <<'EOF'
+0 115 1
+0 116 1
+0 116 0
+0 115 0
+5 115 2
+5 116 2
+1 65535 200
+EOF
+add_check publish_chord c-publish_chord
+
+# a subscriber that does not keep up does not hold actions back
+run_publish_stuck publish_stuck 50000 \
+	-l 148 -t 100000 -a "true" -s 149 -a "touch publish_stuck.ran"
+add_check publish_stuck e-publish_stuck.ran
+
+# --shm-ring file read by the last action: 148 press, release and short
+# press, 149 press, long press and release, 150 press, release and
+# short press
+run_pattern shm_ring 148,1,100 148,0,0 149,1,700 149,0,0 150,1,100 150,0,0 -- \
+	-s 148 -a "true" -l 149 -t 500 -a "true" \
+	-s 150 -a "'$SHMRING_READER' --all -c 9 shm_ring.map > shm_ring" \
+	--shm-ring shm_ring.map
+cat > shm_ring.expected <<'EOF'
+1.000000 key 148 1
+1.100000 key 148 0
+1.100000 key 149 1
+1.110000 short 148 100
+1.600000 long 149 500
+1.800000 key 149 0
+1.800000 key 150 1
+1.900000 key 150 0
+1.910000 short 150 100
+EOF
+add_check shm_ring m-shm_ring
+
+# more messages than slots: the first ones were overwritten, so the
+# reader skips to the oldest it can still read (keeping an eighth of
+# the ring as margin) and counts the others as lost. 5005 messages:
+# 148 press, repeats and release, 150 press, release and short press
+run_pattern shm_ring_overflow 148,1,0 $(printf '148,2,0 %.0s' {1..5000}) \
+	148,0,100 150,1,100 150,0,0 -- \
+	-l 148 -t 100000 -a "true" \
+	-s 150 -a "'$SHMRING_READER' --all -c 5005 shm_ring_overflow.map > shm_ring_overflow" \
+	--shm-ring shm_ring_overflow.map
+cat > shm_ring_overflow.expected <<'EOF'
+lost 1421 messages
+1.100000 key 150 1
+1.200000 key 150 0
+1.210000 short 150 100
+EOF
+add_check shm_ring_overflow m-shm_ring_overflow
+
+# bindings changed while 149 is held: its long press uses the new
+# action, 150 is added, a bad command changes nothing
+run_control control 148,1,100 148,0,100 149,1,600 \
+	"ok:load -s 148 -a 'echo new148 >> control' -l 149 -t 500 -a 'echo new149 >> control' -s 150 -a 'echo new150 >> control'" \
+	"error:add -s 150 -t 2000 -a true -l 150 -t 1000 -a true" \
+	"error:bogus" \
+	149,0,100 150,1,100 150,0,100 148,1,100 148,0,0 -- \
+	-s 148 -a "echo old148 >> control" -l 149 -t 500 -a "echo old149 >> control"
+add_check control l4-control
+
+# chords can be changed like keys. An unbound key (ESC) moves the clock
+# so presses are decided before each command
+run_control control_chord 115,1,0 116,1,100 116,0,0 115,0,100 1,0,0 \
+	"ok:add -s VOLUMEUP+POWER -a 'echo chord >> control_chord'" \
+	115,1,0 116,1,100 116,0,0 115,0,100 1,0,0 \
+	"ok:replace -s POWER+VOLUMEUP -a 'echo new >> control_chord'" \
+	115,1,0 116,1,100 116,0,0 115,0,100 1,0,0 \
+	"ok:remove VOLUMEUP+POWER" \
+	115,1,0 116,1,100 116,0,0 115,0,0 -- \
+	-s VOLUMEUP -a "echo volumeup >> control_chord"
+add_check control_chord l4-control_chord
+
+# chords keep their stats by name when removing one renumbers the others
+run_control control_chord_stats 115,1,0 116,1,100 116,0,0 115,0,100 \
+	113,1,0 114,1,100 114,0,0 113,0,100 \
+	113,1,0 114,1,100 114,0,0 113,0,100 1,0,0 \
+	"ok:remove VOLUMEUP+POWER" 1,0,0 -- \
+	-s VOLUMEUP+POWER -a true -s MUTE+VOLUMEDOWN -a true \
+	--stats-file control_chord_stats
+cat > control_chord_stats.expected <<'EOF'
+key chord (768):
+  presses: 2, debounce merges: 0
+  short actions: 2, long actions: 0, sequence actions: 0, ignored releases: 0
+EOF
+add_check control_chord_stats s-control_chord_stats
+
 check_fail sametime_short /dev/null \
 	-s 148 -t 1000 -a "echo 1" \
 	-s 148 -t 1000 -a "echo 1"
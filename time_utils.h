@@ -25,6 +25,21 @@ static inline long int time_diff_tv(struct timeval *tv1, struct timeval *tv2) {
 		+ (tv1->tv_sec - tv2->tv_sec) * 1000;
 }
 
+/* time difference in nsecs */
+static inline int64_t time_diff_ns(struct timespec *ts1, struct timespec *ts2) {
+	return (int64_t)(ts1->tv_sec - ts2->tv_sec) * NSECS_IN_SEC
+		+ ts1->tv_nsec - ts2->tv_nsec;
+}
+
+/* compare timespecs, return value like strcmp */
+static inline int time_cmp_ts(const struct timespec *ts1, const struct timespec *ts2) {
+	if (ts1->tv_sec != ts2->tv_sec)
+		return ts1->tv_sec < ts2->tv_sec ? -1 : 1;
+	if (ts1->tv_nsec != ts2->tv_nsec)
+		return ts1->tv_nsec < ts2->tv_nsec ? -1 : 1;
+	return 0;
+}
+
 /* add number of msec to given timespec */
 static inline void time_add_ts(struct timespec *ts, int msec) {
 	// avoid overflow on 32 bit platforms (tv_nsec = signed int)
@@ -50,7 +65,16 @@ static inline void time_ts2tv(struct timeval *tv, struct timespec *base, int mse
 	tv->tv_usec %= USECS_IN_SEC;
 }
 
+/* test mode virtual clock: when virtual_time is set, time only moves
+ * when input events are read (see timer_advance) */
+extern bool virtual_time;
+extern struct timespec virtual_now;
+
 static inline void time_gettime(struct timespec *ts) {
+	if (virtual_time) {
+		*ts = virtual_now;
+		return;
+	}
 	int rc = clock_gettime(CLOCK_MONOTONIC, ts);
 	xassert(rc == 0, "Could not get time: %m");
 }
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+
+#include "libbuttond_private.h"
+#include "time_utils.h"
+
+/* timers are kept in a binary min-heap ordered by deadline, then by
+ * order they were armed in so timers set for the same time fire in
+ * a predictable order.
+ * There is at most one timer per key, so the heap never grows after
+ * buttond_start. */
+
+static bool timer_before(struct buttond_timer *t1, struct buttond_timer *t2) {
+	int cmp = time_cmp_ts(&t1->ts, &t2->ts);
+	if (cmp)
+		return cmp < 0;
+	return t1->seq < t2->seq;
+}
+
+static void heap_place(struct buttond *bd, struct buttond_timer *timer, int pos) {
+	bd->timers[pos] = timer;
+	timer->heap_pos = pos;
+}
+
+static void sift_up(struct buttond *bd, int pos) {
+	struct buttond_timer *timer = bd->timers[pos];
+
+	while (pos > 0) {
+		int parent = (pos - 1) / 2;
+		if (!timer_before(timer, bd->timers[parent]))
+			break;
+		heap_place(bd, bd->timers[parent], pos);
+		pos = parent;
+	}
+	heap_place(bd, timer, pos);
+}
+
+static void sift_down(struct buttond *bd, int pos) {
+	struct buttond_timer *timer = bd->timers[pos];
+
+	while (1) {
+		int child = pos * 2 + 1;
+		if (child >= bd->timer_count)
+			break;
+		if (child + 1 < bd->timer_count
+		    && timer_before(bd->timers[child + 1],
+				    bd->timers[child]))
+			child++;
+		if (!timer_before(bd->timers[child], timer))
+			break;
+		heap_place(bd, bd->timers[child], pos);
+		pos = child;
+	}
+	heap_place(bd, timer, pos);
+}
+
+void timer_arm(struct buttond *bd, struct buttond_timer *timer,
+	       struct timespec *ts) {
+	timer->ts = *ts;
+	timer->seq = bd->timer_seq++;
+
+	if (timer_armed(timer)) {
+		/* could go either way */
+		sift_up(bd, timer->heap_pos);
+		sift_down(bd, timer->heap_pos);
+		return;
+	}
+
+	heap_place(bd, timer, bd->timer_count++);
+	sift_up(bd, timer->heap_pos);
+}
+
+void timer_cancel(struct buttond *bd, struct buttond_timer *timer) {
+	if (!timer_armed(timer))
+		return;
+
+	int pos = timer->heap_pos;
+	struct buttond_timer *last = bd->timers[--bd->timer_count];
+	timer->heap_pos = -1;
+	if (last == timer)
+		return;
+	heap_place(bd, last, pos);
+	sift_up(bd, pos);
+	sift_down(bd, last->heap_pos);
+}
+
+struct buttond_timer *timer_pop_expired(struct buttond *bd) {
+	if (bd->timer_count == 0)
+		return NULL;
+
+	struct buttond_timer *timer = bd->timers[0];
+	if (time_cmp_ts(&timer->ts, &bd->now) > 0)
+		return NULL;
+	timer_cancel(bd, timer);
+	return timer;
+}
+
+
+bool buttond_next_timeout(struct buttond *bd, struct timespec *ts) {
+	if (bd->timer_count == 0)
+		return false;
+	*ts = bd->timers[0]->ts;
+	return true;
+}
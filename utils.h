@@ -6,6 +6,8 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -16,6 +18,9 @@
 		exit(EXIT_FAILURE); \
 	} while (0)
 
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
 static inline void *xcalloc(size_t nmemb, size_t size) {
 	void *ptr = calloc(nmemb, size);
 	xassert(ptr, "Allocation failure");
@@ -28,6 +33,19 @@ static inline void *xreallocarray(void *ptr, size_t nmemb, size_t size) {
 	return ptr;
 }
 
+/* bitmap helpers, using the byte layout evdev ioctls expect */
+static inline bool is_bit_set(const unsigned char *bitmap, unsigned int bit) {
+	return !!(bitmap[bit / 8] & (1 << (bit % 8)));
+}
+
+static inline void set_bit(unsigned char *bitmap, unsigned int bit) {
+	bitmap[bit / 8] |= 1 << (bit % 8);
+}
+
+static inline void clear_bit(unsigned char *bitmap, unsigned int bit) {
+	bitmap[bit / 8] &= ~(1 << (bit % 8));
+}
+
 static inline ssize_t read_safe(int fd, void *buf, ssize_t count) {
 	ssize_t total = 0;
 